@@ -0,0 +1,46 @@
+#include "AutoMoveRules.hpp"
+
+using namespace solitaire;
+
+const char* solitaire::AutoMoveRuleToStr(AutoMoveRule rule) {
+	switch (rule) {
+	case AutoMoveRule::SAFE_FOUNDATION: return "foundation";
+	case AutoMoveRule::KING_TO_SPACE:   return "king";
+	case AutoMoveRule::DRAW_ONE_STOCK:  return "draw-one-stock";
+	case AutoMoveRule::FORCED_MOVE:     return "forced";
+	default:
+		return "?";
+	}
+}
+
+bool solitaire::ParseAutoMoveRules(std::string_view names, AutoMoveRuleSet& out_rules) {
+	AutoMoveRuleSet rules = 0;
+	while (!names.empty()) {
+		const size_t end = names.find(',');
+		const std::string_view name = names.substr(0, end);
+		names = end == std::string_view::npos ? std::string_view{} : names.substr(end + 1);
+		if (name.empty() || name == "none")
+			continue;
+		bool found = false;
+		for (u8 i = 0; i < NUM_AUTO_MOVE_RULES; ++i) {
+			if (name == AutoMoveRuleToStr(static_cast<AutoMoveRule>(i))) {
+				rules |= AutoMoveRuleBit(static_cast<AutoMoveRule>(i));
+				found = true;
+				break;
+			}
+		}
+		if (!found)
+			return false;
+	}
+	out_rules = rules;
+	return true;
+}
+
+std::string solitaire::AutoMoveRulesToStr(AutoMoveRuleSet rules) {
+	std::string str;
+	for (u8 i = 0; i < NUM_AUTO_MOVE_RULES; ++i) {
+		if (rules & AutoMoveRuleBit(static_cast<AutoMoveRule>(i)))
+			str += (str.empty() ? "" : ",") + std::string(AutoMoveRuleToStr(static_cast<AutoMoveRule>(i)));
+	}
+	return str.empty() ? "none" : str;
+}
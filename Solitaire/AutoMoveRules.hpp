@@ -0,0 +1,33 @@
+#pragma once
+
+#include "units.hpp"
+
+#include <array>
+#include <string>
+#include <string_view>
+
+namespace solitaire {
+	// Provably safe moves that the solver makes without branching on them.
+	// Each rule can be enabled separately, and the solver counts how many moves each one makes.
+	enum class AutoMoveRule : u8 {
+		SAFE_FOUNDATION, // Tableau or stock card to the foundation, when both opposite colour foundations are within two ranks of it.
+		KING_TO_SPACE,   // King (or run starting with one) to an empty tableau spot, when there is a spot for every king.
+		DRAW_ONE_STOCK,  // Safe foundation card from anywhere ahead in the stock. Only for draw one with unlimited redeals, where taking a card can't change what's reachable.
+		FORCED_MOVE,     // The only move found by move generation. Skips branching, and the priority sort, on the state in between.
+		TOTAL_RULES,
+	};
+	constexpr u8 NUM_AUTO_MOVE_RULES = toUType(AutoMoveRule::TOTAL_RULES);
+
+	using AutoMoveRuleSet = u32; // One bit per enabled rule.
+	using AutoMoveCounts = std::array<u64, NUM_AUTO_MOVE_RULES>;
+
+	constexpr AutoMoveRuleSet AutoMoveRuleBit(AutoMoveRule rule) {
+		return AutoMoveRuleSet{ 1 } << toUType(rule);
+	}
+	constexpr AutoMoveRuleSet DEFAULT_AUTO_MOVE_RULES = AutoMoveRuleBit(AutoMoveRule::SAFE_FOUNDATION) | AutoMoveRuleBit(AutoMoveRule::KING_TO_SPACE);
+
+	const char* AutoMoveRuleToStr(AutoMoveRule rule);
+	// Parse a comma separated list of rule names ("none" for no rules). Returns false if a name isn't recognized.
+	bool ParseAutoMoveRules(std::string_view names, AutoMoveRuleSet& out_rules);
+	std::string AutoMoveRulesToStr(AutoMoveRuleSet rules);
+}
@@ -92,4 +92,36 @@ namespace solitaire {
 	inline std::string CardToStr(const Card& c) {
 		return RankToStr(c.getRank()) + SuitToChar(c.getSuit());
 	}
+
+	// A set of cards from a single deck, one bit per card.
+	using CardMask = u64;
+
+	// Index of a card in [0,51], ordered by suit, then rank.
+	constexpr u8 GetCardIndex(Suit s, Rank r) {
+		return static_cast<u8>(toUType(s) * CARDS_PER_SUIT + r - 1);
+	}
+	inline u8 GetCardIndex(const Card& c) {
+		return GetCardIndex(c.getSuit(), c.getRank());
+	}
+	constexpr CardMask CardBit(Suit s, Rank r) {
+		return CardMask{ 1 } << GetCardIndex(s, r);
+	}
+	inline Card CardFromIndex(u8 index) {
+		return Card(static_cast<Suit>(index / CARDS_PER_SUIT), static_cast<Rank>(index % CARDS_PER_SUIT + 1));
+	}
+	inline CardMask CardBit(const Card& c) {
+		return CardMask{ 1 } << GetCardIndex(c);
+	}
+	// All cards of a suit, up to and including the given rank.
+	constexpr CardMask SuitMask(Suit s, Rank upTo = CARDS_PER_SUIT) {
+		return ((CardMask{ 1 } << (upTo < CARDS_PER_SUIT ? upTo : CARDS_PER_SUIT)) - 1) << (toUType(s) * CARDS_PER_SUIT);
+	}
+	// All red or black cards, up to and including the given rank.
+	constexpr CardMask ColourMask(bool red, Rank upTo = CARDS_PER_SUIT) {
+		return red ? SuitMask(Suit::HEARTS, upTo) | SuitMask(Suit::DIAMONDS, upTo) : SuitMask(Suit::CLUBS, upTo) | SuitMask(Suit::SPADES, upTo);
+	}
+	// All cards of the given rank.
+	constexpr CardMask RankMask(Rank r) {
+		return CardBit(Suit::HEARTS, r) | CardBit(Suit::DIAMONDS, r) | CardBit(Suit::CLUBS, r) | CardBit(Suit::SPADES, r);
+	}
 }
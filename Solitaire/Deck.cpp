@@ -1,10 +1,24 @@
 #include "Deck.hpp"
 
+#include <algorithm>
 #include <random>
 
 #include "Card.hpp"
 
 namespace solitaire {
+	void Pile::flipCard(u8 ind) {
+		Card& c = deck_[ind];
+		if (c.isFaceUp())
+			++face_down_;
+		else
+			--face_down_;
+		c.flipCard();
+	}
+
+	void Pile::_count_face_down() {
+		face_down_ = static_cast<u8>(std::count_if(deck_.cbegin(), deck_.cend(), [](const Card& c) { return !c.isFaceUp(); }));
+	}
+
 	void Pile::MoveCards(Pile& from, Pile& to, u8 numCards) {
 		const auto start(from.deck_.end() - numCards);
 		to.deck_.insert(to.deck_.end(), std::make_move_iterator(start), std::make_move_iterator(from.deck_.end()));
@@ -5,6 +5,7 @@
 
 #include <vector>
 #include <string>
+#include <utility>
 
 namespace solitaire {
 	class Card;
@@ -25,14 +26,18 @@ namespace solitaire {
 	public:
 		Pile() = default;
 		Pile(PileType t) : type_(t) {}
-		Pile(PileType t, const Deck& d) : type_(t), deck_(d) {}
-		Pile(PileType t, Deck&& d) : type_(t), deck_(std::move(d)) {}
+		Pile(PileType t, const Deck& d) : type_(t), deck_(d) { _count_face_down(); }
+		Pile(PileType t, Deck&& d) : type_(t), deck_(std::move(d)) { _count_face_down(); }
 
 		inline Card& operator[](u8 ind) { return deck_[ind]; }
 		inline const Card& operator[](u8 ind) const { return deck_[ind]; }
 		inline bool  operator==(const Pile& o) const { return type_ == o.type_ && deck_ == o.deck_; }
 		inline bool  hasCards() const { return !deck_.empty(); }
 		inline u8    size() const { return static_cast<u8>(deck_.size()); }
+		// Face-down cards are always at the bottom of the pile, so this is also the index of the first face-up card.
+		inline u8    getNumFaceDown() const { return face_down_; }
+		// Number of face-up cards at the top of the pile.
+		inline u8    getRunLength() const { return size() - face_down_; }
 		// Get a card starting from the "top" of the pile (topmost card is not overlapped by any other card).
 		inline const Card& getFromTop(u8 pos = 0) const {
 			return deck_[deck_.size() - (1 + pos)]; 
@@ -42,14 +47,21 @@ namespace solitaire {
 			return const_cast<Card&>(std::as_const(*this).getFromTop(pos));
 		}
 
-		// Move cards from the end of pile "from" to the end of pile "to".
+		// Flip a card over, keeping the pile's face-down count up to date. Cards should not be flipped through operator[].
+		void flipCard(u8 ind);
+		void flipTopCard() { flipCard(size() - 1); }
+
+		// Move cards from the end of pile "from" to the end of pile "to". Moved cards must be face up.
 		static void MoveCards(Pile& from, Pile& to, u8 numCards);
 		// Move a card from the given position in pile "from" to the given position in pile "to".
 		// If the given position is < 0, moves from/to the end of that pile.
 		static void MoveCard(Pile& from, s32 fromPosition, Pile& to, s32 toPosition=-1);
 
 	private:
+		void _count_face_down();
+
 		PileType type_;
 		Deck deck_;
+		u8 face_down_ = 0;
 	};
 }
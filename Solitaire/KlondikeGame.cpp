@@ -1,5 +1,6 @@
 #include "KlondikeGame.hpp"
 
+#include <array>
 #include <iomanip>
 #include <sstream>
 #include <string>
@@ -26,19 +27,46 @@ namespace {
 	const char* const BORDER = "----------------------------------------------------------------\n";
 
 	const u8 CARD_HEIGHT = 4;
+
+	// Reachable stock positions for every stock size and position, following KlondikeGame::getNextInStock.
+	template <u8 DrawCount>
+	struct StockReachTable {
+		using Row = std::array<KlondikeBoard::StockPositions, KlondikeBoard::MAX_STOCK_SIZE>;
+		std::array<Row, KlondikeBoard::MAX_STOCK_SIZE + 1> reach{};
+
+		constexpr StockReachTable() {
+			for (unsigned size = 1; size <= KlondikeBoard::MAX_STOCK_SIZE; ++size) {
+				for (unsigned position = 0; position < size; ++position) {
+					KlondikeBoard::StockPositions positions = 0;
+					for (unsigned i = position; i < size; i = i == size - 1 ? size : (i + DrawCount < size ? i + DrawCount : size - 1))
+						positions |= KlondikeBoard::StockPositions(1) << i;
+					reach[size][position] = positions;
+				}
+			}
+		}
+	};
+	template <u8 DrawCount>
+	constexpr StockReachTable<DrawCount> STOCK_REACH{};
 }
 
-void KlondikeGame::setUpGame() {
-	stock = Pile(PileType::STOCK, GenDeck(seed_));
+template <typename Rules>
+void KlondikeGame<Rules>::setUpGame() {
+	setUpGame(GenDeck(seed_));
+}
+
+template <typename Rules>
+void KlondikeGame<Rules>::setUpGame(Deck deck) {
+	stock = Pile(PileType::STOCK, std::move(deck));
 	for (u8 i = 0; i < NUM_TABLEAU_PILES; ++i) {
 		Pile::MoveCards(stock, tableau[i], i + 1);
 		for (u8 k = 0; k < i; ++k)
-			tableau[i][k].flipCard(); // Flip all but the topmost card.
+			tableau[i].flipCard(k); // Flip all but the topmost card.
 	}
 	repileStock();
+	redeals_ = 0;
 }
 
-const Pile& KlondikeGame::getPile(const PileID& id) const {
+const Pile& KlondikeBoard::getPile(const PileID& id) const {
 	switch (id.type) {
 	case PileType::STOCK:
 		return stock;
@@ -52,11 +80,11 @@ const Pile& KlondikeGame::getPile(const PileID& id) const {
 	}
 }
 
-Pile& KlondikeGame::getPile(const PileID& id) {
+Pile& KlondikeBoard::getPile(const PileID& id) {
 	return const_cast<Pile&>(std::as_const(*this).getPile(id));
 }
 
-bool KlondikeGame::isGameWon() const {
+bool KlondikeBoard::isGameWon() const {
 	if (stock.hasCards())
 		return false;
 	for (u8 i = 0; i < NUM_TABLEAU_PILES; ++i) {
@@ -75,7 +103,8 @@ bool KlondikeGame::isGameWon() const {
 	return true;
 }
 
-bool KlondikeGame::isStockDirty() const {
+template <typename Rules>
+bool KlondikeGame<Rules>::isStockDirty() const {
 	if (!stock.hasCards())
 		return false; // No cards left.
 	if (stock_position_ == NUM_STOCK_CARD_DRAW - 1)
@@ -85,19 +114,50 @@ bool KlondikeGame::isStockDirty() const {
 	return true;
 }
 
-void KlondikeGame::repileStock() {
+template <typename Rules>
+void KlondikeGame<Rules>::repileStock() {
 	// This can cause overflow when we are out of cards, but is safe because we can never use stock_position_ without checking if the stock is empty anyway.
-	stock_position_ = stock.size() < NUM_STOCK_CARD_DRAW ? stock.size() - 1 : NUM_STOCK_CARD_DRAW - 1;
+	stock_position_ = getStockStartPosition(stock.size());
+}
+
+template <typename Rules>
+void KlondikeGame<Rules>::redealStock() {
+	if constexpr (Rules::REDEAL_LIMIT != UNLIMITED_REDEALS)
+		++redeals_;
+	repileStock();
+}
+
+template <typename Rules>
+void KlondikeGame<Rules>::undoRedealStock(u8 previousPosition) {
+	if constexpr (Rules::REDEAL_LIMIT != UNLIMITED_REDEALS)
+		--redeals_;
+	stock_position_ = previousPosition;
 }
 
-u8 KlondikeGame::getNextInStock(u8 fromPosition) const {
+template <typename Rules>
+u8 KlondikeGame<Rules>::getNextInStock(u8 fromPosition) const {
 	if (static_cast<int>(fromPosition) >= static_cast<int>(stock.size() - 1))
 		return stock.size();
 	fromPosition += NUM_STOCK_CARD_DRAW;
 	return fromPosition < stock.size() ? fromPosition : stock.size() - 1;
 }
 
-void KlondikeGame::printGame(std::ostream& output) const {
+template <typename Rules>
+KlondikeBoard::StockPositions KlondikeGame<Rules>::getReachableStock(u8 fromPosition) const {
+	return fromPosition < stock.size() ? STOCK_REACH<NUM_STOCK_CARD_DRAW>.reach[stock.size()][fromPosition] : 0;
+}
+
+template <typename Rules>
+u8 KlondikeGame<Rules>::getCanonicalStockPosition() const {
+	if constexpr (Rules::REDEAL_LIMIT != UNLIMITED_REDEALS) {
+		return stock_position_; // Positions that need a repile to get back to the start have fewer redeals left.
+	} else {
+		const u8 start = getStockStartPosition(stock.size());
+		return (getReachableStock(stock_position_) & ~getReachableStock(start)) == 0 ? start : stock_position_;
+	}
+}
+
+void KlondikeBoard::printGame(std::ostream& output) const {
 	output << BORDER;
 
 	// Print stock as a string of entries.
@@ -169,3 +229,6 @@ void KlondikeGame::printGame(std::ostream& output) const {
 
 	output << BORDER;
 }
+
+template class solitaire::KlondikeGame<DrawOneRules>;
+template class solitaire::KlondikeGame<DrawThreeRules>;
@@ -4,26 +4,47 @@
 #include "Card.hpp"
 #include "Deck.hpp"
 
+#include <cstdint>
 #include <iostream>
 #include <ostream>
 #include <vector>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 namespace solitaire {
 	struct PileID {
 		PileType type = PileType::NONE;
 		u8 index = 0;
 	};
 
-	class KlondikeGame {
+	constexpr u8 UNLIMITED_REDEALS = 0xFF;
+
+	// Ruleset policy for a Klondike variant. Games and solvers are specialized on a ruleset at compile time,
+	// so rule checks in the hot search loops fold down to constants.
+	template <u8 DrawCount, u8 RedealLimit = UNLIMITED_REDEALS, bool FoundationToTableau = false>
+	struct KlondikeRules {
+		static_assert(DrawCount > 0, "Must draw at least one card from the stock at a time.");
+		static constexpr u8   NUM_STOCK_CARD_DRAW = DrawCount;             // Number of cards to deal from the stock at a time.
+		static constexpr u8   REDEAL_LIMIT = RedealLimit;                  // Number of times the stock can be repiled (UNLIMITED_REDEALS for no limit).
+		static constexpr bool FOUNDATION_TO_TABLEAU = FoundationToTableau; // Whether cards can be moved from the foundation back to the tableau.
+	};
+
+	using DrawOneRules   = KlondikeRules<1>;
+	using DrawThreeRules = KlondikeRules<3>;
+
+	// Piles and stock position of a Klondike game. Everything here is the same for all rulesets.
+	class KlondikeBoard {
 	public:
 		static constexpr u8 NUM_TABLEAU_PILES = 7;
 		static constexpr u8 NUM_FOUNDATION_PILES = static_cast<u8>(Suit::TOTAL_SUITS);
-		static constexpr u8 NUM_STOCK_CARD_DRAW = 3; // Number of cards to deal from the stock at a time.
+		static constexpr u8 MAX_STOCK_SIZE = CARDS_PER_DECK - NUM_TABLEAU_PILES * (NUM_TABLEAU_PILES + 1) / 2;
 
-		KlondikeGame() = default;
-		KlondikeGame(u64 seed) noexcept : seed_(seed) {}
+		using StockPositions = std::uint32_t; // A bit per stock position.
 
-		void setUpGame();
+		KlondikeBoard() = default;
+		KlondikeBoard(u64 seed) noexcept : seed_(seed) {}
 
 		Pile&       getPile(const PileID& id);
 		const Pile& getPile(const PileID& id) const;
@@ -33,11 +54,6 @@ namespace solitaire {
 		u64  getSeed() const { return seed_; }
 
 		bool isGameWon() const;
-		bool isStockDirty() const; // Whether the stock can be repiled (stock position is not pointing to the first available card).
-		void repileStock(); // Equivalent to dealing all of stock to waste, and then back to stock.
-		// Get next card from the stock, from a given position.
-		// If from position is the last card in the stock, returns stock.size().
-		u8 getNextInStock(u8 fromPosition) const;
 
 		void printGame(std::ostream& output = std::cout) const;
 
@@ -47,7 +63,55 @@ namespace solitaire {
 		std::vector<Pile> foundation{ NUM_FOUNDATION_PILES, Pile(PileType::FOUNDATION) };
 		Pile stock{ PileType::STOCK };
 
-	private:
+	protected:
 		u8 stock_position_{ 0 };
 	};
+
+	template <typename Rules>
+	class KlondikeGame : public KlondikeBoard {
+	public:
+		using RulesType = Rules;
+		static constexpr u8 NUM_STOCK_CARD_DRAW = Rules::NUM_STOCK_CARD_DRAW;
+
+		KlondikeGame() = default;
+		KlondikeGame(u64 seed) noexcept : KlondikeBoard(seed) {}
+
+		void setUpGame();
+		// Deal a given deck instead of the seed's, in the same order (EG to solve a board from elsewhere).
+		void setUpGame(Deck deck);
+
+		u8   getRedeals() const { return redeals_; }
+		bool canRedealStock() const { return Rules::REDEAL_LIMIT == UNLIMITED_REDEALS || redeals_ < Rules::REDEAL_LIMIT; }
+		bool isStockDirty() const; // Whether the stock can be repiled (stock position is not pointing to the first available card).
+		void repileStock(); // Equivalent to dealing all of stock to waste, and then back to stock.
+		void redealStock(); // Repile the stock as a player move, counting towards the redeal limit.
+		void undoRedealStock(u8 previousPosition);
+		// Get next card from the stock, from a given position.
+		// If from position is the last card in the stock, returns stock.size().
+		u8 getNextInStock(u8 fromPosition) const;
+		// Stock positions that can be dealt to from a position without repiling (looked up in a table built per draw count).
+		StockPositions getReachableStock(u8 fromPosition) const;
+		// Position a stock of the given size is dealt from after a repile.
+		static u8 getStockStartPosition(u8 stockSize) { return static_cast<u8>(stockSize < NUM_STOCK_CARD_DRAW ? stockSize - 1 : NUM_STOCK_CARD_DRAW - 1); }
+		// Stock position to tell states apart by. With unlimited redeals, positions that can only deal cards the start position can deal
+		// play the same as the start position.
+		u8 getCanonicalStockPosition() const;
+
+	private:
+		u8 redeals_{ 0 };
+	};
+
+	// Lowest position in a non-empty set of stock positions.
+	inline u8 LowestStockPosition(KlondikeBoard::StockPositions positions) {
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, positions);
+		return static_cast<u8>(index);
+#else
+		return static_cast<u8>(__builtin_ctz(positions));
+#endif
+	}
+
+	extern template class KlondikeGame<DrawOneRules>;
+	extern template class KlondikeGame<DrawThreeRules>;
 }
@@ -2,7 +2,9 @@
 
 #include <algorithm>
 #include <climits>
+#include <cstring>
 #include <iostream>
+#include <iterator>
 #include <string>
 
 #include "units.hpp"
@@ -10,73 +12,94 @@
 using namespace solitaire;
 
 namespace {
-
-	// -------------------------------- Move Strategy -----------------------------------------------
-	// Numbers are padded such that if their base priority is EG 100, then they can be subtracted from to make them higher priority.
-	enum class Priority : u32 {
-		REVEAL = 100,                // Moves that reveal a card. Number indicates how many cards are flipped in the stack (Klondike has max 6).
-		CLEAR_WITH_KING = 200,       // Clearning an empty board spot when there is a king available to occupy it.
-		STOCK = 300,                 // Moves from stock pile (to tableau or foundation). Higher priority towards the end of the stock pile.
-		TABLEAU_TO_FOUNDATION = 400,
-		REPILE_STOCK = 400,
-		PARTIAL = 600,               // Intra-tableau moves that don't reveal a card or clear a space.
+	struct CheckpointHeader {
+		char magic[8]{ 'S', 'O', 'L', 'S', 'E', 'A', 'R', 'C' };
+		std::uint32_t solverVersion{ SOLVER_VERSION };
+		std::uint32_t rules{ 0 }; // Draw count, redeal limit and foundation to tableau moves.
 	};
+	static_assert(sizeof(CheckpointHeader) == 16);
 
-	// ----------------------------------------------------------------------------------------------
+	template <typename Rules>
+	constexpr std::uint32_t _checkpoint_rules() {
+		return std::uint32_t{ Rules::NUM_STOCK_CARD_DRAW } << 16 | std::uint32_t{ Rules::REDEAL_LIMIT } << 8 | (Rules::FOUNDATION_TO_TABLEAU ? 1u : 0u);
+	}
 
-	bool _can_place_card(const Card& lower, const Card& higher) {
-		return IsRed(lower.getSuit()) != IsRed(higher.getSuit()) && lower.getRank() == higher.getRank() - 1;
+	template <typename T>
+	void _write_value(std::ostream& out, const T& value) {
+		out.write(reinterpret_cast<const char*>(&value), sizeof(value));
 	}
-	bool _can_move_to_foundation(const Card& card, const std::vector<Pile>& foundation) {
-		const Pile& pile = foundation[toUType(card.getSuit())];
-		if (!pile.hasCards())
-			return card.getRank() == 1;
-		return pile.getFromTop().getRank() == card.getRank() - 1;
+
+	template <typename T>
+	bool _read_value(std::istream& in, T& out_value) {
+		return static_cast<bool>(in.read(reinterpret_cast<char*>(&out_value), sizeof(out_value)));
+	}
+
+	void _write_moves(std::ostream& out, const MoveList& moves) {
+		_write_value(out, static_cast<u64>(moves.size()));
+		for (const Move& move : moves)
+			_write_value(out, move.getCode());
+	}
+
+	bool _read_moves(std::istream& in, MoveList& out_moves) {
+		u64 size = 0;
+		if (!_read_value(in, size) || size > (1u << 20))
+			return false;
+		out_moves.resize(size);
+		for (Move& move : out_moves) {
+			std::uint32_t code;
+			if (!_read_value(in, code))
+				return false;
+			move = Move::FromCode(code);
+		}
+		return true;
 	}
 
-	// If the card can be moved to the foundation immediately without impacting chances of game success.
-	bool _guaranteed_move_to_foundation(const Card& card, const std::vector<Pile>& foundation) {
-		Rank minRank;
-		if (IsRed(card.getSuit())) // Check black foundations.
-			minRank = static_cast<Rank>(std::min(foundation[toUType(Suit::CLUBS)].size(), foundation[toUType(Suit::SPADES)].size()));
-		else // Check red foundations.
-			minRank = static_cast<Rank>(std::min(foundation[toUType(Suit::HEARTS)].size(), foundation[toUType(Suit::DIAMONDS)].size()));
-		return _can_move_to_foundation(card, foundation) && card.getRank() <= minRank + 2;
+	bool _can_place_card(const Card& lower, const Card& higher) {
+		return IsRed(lower.getSuit()) != IsRed(higher.getSuit()) && lower.getRank() == higher.getRank() - 1;
 	}
 	// Find first face-up card for the pile. Returns whether a run was found (false if pile has no cards).
 	bool _find_top_of_run(const Pile& pile, u8& out_run_length, Card* optional_out_card = nullptr) {
-		for (u8 i = 0; i < pile.size(); ++i) {
-			if (pile[i].isFaceUp()) {
-				if (optional_out_card)
-					*optional_out_card = pile[i];
-				out_run_length = pile.size() - i;
-				return true;
-			}
-		}
-		return false; // Pile is empty.
+		out_run_length = pile.getRunLength();
+		if (out_run_length == 0)
+			return false; // Pile is empty.
+		if (optional_out_card)
+			*optional_out_card = pile[pile.getNumFaceDown()];
+		return true;
 	}
-	// Find the first available spot to move a card to, if it exists.
-	bool _find_tableau_to_tableau_move(const Card& card, const std::vector<Pile>& tableau, u8 fromTableau, u8& out_to_tableau) {
-		for (u8 i = 0; i < KlondikeGame::NUM_TABLEAU_PILES; ++i) {
-			if (i == fromTableau)
-				continue; // Can't move to itself.
-			if (!tableau[i].hasCards()) {
-				if (card.getRank() == RANK_KING) { // Move king over to empty spot.
-					out_to_tableau = i;
-					return true;
-				}
-			} else if (_can_place_card(card, tableau[i].getFromTop())) { // Move card over to first available spot.
-				out_to_tableau = i;
-				return true;
-			}
+	// Find the first available spot to move a card to, if it exists. A king can only go to an empty spot.
+	bool _find_tableau_to_tableau_move(PileMask targetPiles, u8 fromTableau, u8& out_to_tableau) {
+		targetPiles &= ~static_cast<PileMask>(1u << fromTableau); // Can't move to itself.
+		if (targetPiles == 0)
+			return false;
+		out_to_tableau = LowestPile(targetPiles);
+		return true;
+	}
+	// Stable insertion sort, by priority. Stages only hold a handful of moves, and this doesn't allocate.
+	template <typename Iterator>
+	void _sort_by_priority(Iterator first, Iterator last) {
+		for (Iterator i = first; i != last; ++i) {
+			auto move = *i;
+			Iterator j = i;
+			for (; j != first && move.priority < (j - 1)->priority; --j)
+				*j = *(j - 1);
+			*j = move;
 		}
-		return false;
+	}
+	// Whether two moves can be played in either order, each leaving the other available, to reach the same position.
+	// Kept to whole runs moved off the tableau between different piles. Stock moves shift the stock position, and partial run moves
+	// depend on the path taken.
+	bool _are_independent(const Move& a, const Move& b) {
+		if (a.getType() != MoveType::TABLEAU || b.getType() != MoveType::TABLEAU || a.getFromPile().type != PileType::TABLEAU || b.getFromPile().type != PileType::TABLEAU)
+			return false;
+		auto same = [](const PileID& x, const PileID& y) { return x.type == y.type && x.index == y.index; };
+		return !same(a.getFromPile(), b.getFromPile()) && !same(a.getFromPile(), b.getToPile())
+			&& !same(a.getToPile(), b.getFromPile()) && !same(a.getToPile(), b.getToPile());
 	}
 	// See if there is room in the tableau for all the kings. If there is, return an empty spot to place a king in.
 	// This function "cheats", by peeking under flipped cards at the base of tableau piles.
 	bool _has_space_for_all_kings(const std::vector<Pile>& tableau, u8& emptySpot) {
 		u8 numKingSpaces = 0;
-		for (u8 i = 0; i < KlondikeGame::NUM_TABLEAU_PILES; ++i) {
+		for (u8 i = 0; i < KlondikeBoard::NUM_TABLEAU_PILES; ++i) {
 			if (!tableau[i].hasCards()) {
 				emptySpot = i;
 				++numKingSpaces;
@@ -85,142 +108,244 @@ namespace {
 		}
 		return numKingSpaces >= toUType(Suit::TOTAL_SUITS);
 	}
+}
 
-	std::unique_ptr<Move> _find_guaranteed_stock_move(u8 testStockPosition, const KlondikeGame& game) {
-		const Card& c = game.stock[testStockPosition];
-		// Check for a guaranteed moves to the foundation.
-		if (_guaranteed_move_to_foundation(c, game.foundation))
-			return std::make_unique<Move>(Move::Stock(c, game.getStockPosition(), testStockPosition, PileID{ PileType::FOUNDATION, toUType(c.getSuit()) }));
-		// Check if it's a king, and see if there are enough tableau spaces to guarantee it has room.
-		if (u8 emptySpot{ 0 }; c.getRank() == RANK_KING && _has_space_for_all_kings(game.tableau, emptySpot))
-			return std::make_unique<Move>(Move::Stock(c, game.getStockPosition(), testStockPosition, PileID{ PileType::TABLEAU, emptySpot }));
-		return nullptr;
-	}
+template <typename Rules>
+bool KlondikeSolver<Rules>::_is_king_available() const {
+	return ((run_tops_ | stock_available_) & RankMask(RANK_KING)) != 0;
 }
 
-bool KlondikeSolver::_is_king_available() const {
-	Card card;
-	u8 unused;
-	for (const auto& pile : game_.tableau) {
-		if (_find_top_of_run(pile, unused, &card) && card.getRank() == RANK_KING)
-			return true;
-	}
-	for (u8 i = game_.getStockPosition(); i < game_.stock.size(); i = game_.getNextInStock(i)) {
-		if (game_.stock[i].getRank() == RANK_KING)
-			return true;
-	}
-	return false;
+template <typename Rules>
+bool KlondikeSolver<Rules>::_is_card_available(const Card& cardToFind) const {
+	return ((tableau_tops_ | stock_available_) & CardBit(cardToFind)) != 0;
+}
+
+template <typename Rules>
+void KlondikeSolver<Rules>::_rebuild_card_masks() {
+	tableau_tops_ = run_tops_ = foundation_playable_ = partial_run_moved_ = 0;
+	tableau_targets_ = 0;
+	for (u8 i = 0; i < KlondikeBoard::NUM_TABLEAU_PILES; ++i)
+		_toggle_pile_masks(PileID{ PileType::TABLEAU, i });
+	for (u8 i = 0; i < KlondikeBoard::NUM_FOUNDATION_PILES; ++i)
+		_toggle_pile_masks(PileID{ PileType::FOUNDATION, i });
+	_update_stock_mask();
 }
 
-bool KlondikeSolver::_is_card_available(const Card& cardToFind) const {
-	for (const auto& pile : game_.tableau) {
-		if (pile.hasCards() && cardToFind == pile.getFromTop())
-			return true;
+template <typename Rules>
+void KlondikeSolver<Rules>::_toggle_pile_masks(const PileID& id) {
+	switch (id.type) {
+	case PileType::TABLEAU:
+	{
+		const Pile& pile = game_.tableau[id.index];
+		u8 runLength;
+		Card topOfRun;
+		if (_find_top_of_run(pile, runLength, &topOfRun)) {
+			tableau_tops_ ^= CardBit(pile.getFromTop());
+			run_tops_ ^= CardBit(topOfRun);
+		}
+		// Targets are set from the pile as it is, so the call after a move leaves them up to date.
+		tableau_targets_ = SetTableauTarget(tableau_targets_, id.index, pile.hasCards() ? TableauTarget(pile.getFromTop()) : EMPTY_PILE_TARGET);
+		break;
 	}
-	for (u8 i = game_.getStockPosition(); i < game_.stock.size(); i = game_.getNextInStock(i)) {
-		if (cardToFind == game_.stock[i])
-			return true;
+	case PileType::FOUNDATION:
+		if (const u8 size = game_.foundation[id.index].size(); size < CARDS_PER_SUIT)
+			foundation_playable_ ^= CardBit(Suit(id.index), size + 1);
+		break;
+	default:
+		break; // The stock mask depends on the stock position, so it is rebuilt instead.
 	}
-	return false;
 }
 
-std::unique_ptr<Move> KlondikeSolver::_find_auto_move() {
+template <typename Rules>
+typename KlondikeSolver<Rules>::StockReach KlondikeSolver<Rules>::_stock_reach() const {
+	const StockPositions direct = game_.getReachableStock(game_.getStockPosition());
+	if (!game_.isStockDirty() || !game_.canRedealStock())
+		return StockReach{ direct, 0 };
+	return StockReach{ direct, game_.getReachableStock(Game::getStockStartPosition(game_.stock.size())) & ~direct };
+}
+
+template <typename Rules>
+void KlondikeSolver<Rules>::_update_stock_mask() {
+	stock_available_ = 0;
+	const StockReach reach = _stock_reach();
+	for (StockPositions positions = reach.direct | reach.afterRepile; positions != 0; positions &= positions - 1)
+		stock_available_ |= CardBit(game_.stock[LowestStockPosition(positions)]);
+}
+
+template <typename Rules>
+CardMask KlondikeSolver<Rules>::_safe_foundation_cards() const {
+	// A card can be moved to the foundation immediately without impacting chances of game success if both opposite colour
+	// foundations are within two ranks of it: any card that could be placed on it can go to the foundation instead.
+	const Rank minRed = static_cast<Rank>(std::min(game_.foundation[toUType(Suit::HEARTS)].size(), game_.foundation[toUType(Suit::DIAMONDS)].size()));
+	const Rank minBlack = static_cast<Rank>(std::min(game_.foundation[toUType(Suit::CLUBS)].size(), game_.foundation[toUType(Suit::SPADES)].size()));
+	return ColourMask(true, minBlack + 2) | ColourMask(false, minRed + 2);
+}
+
+template <typename Rules>
+std::optional<Move> KlondikeSolver<Rules>::_use_auto_move(AutoMoveRule rule, const Move& move) {
+	++auto_move_counts_[toUType(rule)];
+	return move;
+}
+
+template <typename Rules>
+std::optional<Move> KlondikeSolver<Rules>::_find_stock_auto_move(u8 testStockPosition, CardMask safeCards) {
+	const Card& c = game_.stock[testStockPosition];
+	// Check for a guaranteed moves to the foundation.
+	if (_is_rule_enabled(AutoMoveRule::SAFE_FOUNDATION) && (safeCards & CardBit(c)))
+		return _use_auto_move(AutoMoveRule::SAFE_FOUNDATION, Move::Stock(c, game_.getStockPosition(), testStockPosition, PileID{ PileType::FOUNDATION, toUType(c.getSuit()) }));
+	// Check if it's a king, and see if there are enough tableau spaces to guarantee it has room.
+	if (u8 emptySpot{ 0 }; _is_rule_enabled(AutoMoveRule::KING_TO_SPACE) && c.getRank() == RANK_KING && _has_space_for_all_kings(game_.tableau, emptySpot))
+		return _use_auto_move(AutoMoveRule::KING_TO_SPACE, Move::Stock(c, game_.getStockPosition(), testStockPosition, PileID{ PileType::TABLEAU, emptySpot }));
+	return std::nullopt;
+}
+
+template <typename Rules>
+std::optional<Move> KlondikeSolver<Rules>::_find_auto_move() {
 	// Auto moves can change the state of the board and interfere with each other, so only do one at a time.
+	// The card masks tell us up front whether any rule could apply, so piles and stock positions are only rescanned when something changed.
+	const CardMask safeCards = _is_rule_enabled(AutoMoveRule::SAFE_FOUNDATION) || _is_rule_enabled(AutoMoveRule::DRAW_ONE_STOCK) ? foundation_playable_ & _safe_foundation_cards() : 0;
+	const CardMask kings = _is_rule_enabled(AutoMoveRule::KING_TO_SPACE) ? RankMask(RANK_KING) : 0;
+
 	// Find auto-moves in the tableau.
-	for (u8 i = 0; i < KlondikeGame::NUM_TABLEAU_PILES; ++i) {
-		if (!game_.tableau[i].hasCards())
-			continue;
-		// Check for a guaranteed move to the foundation.
-		if (const Card& c = game_.tableau[i].getFromTop(); _guaranteed_move_to_foundation(c, game_.foundation)) {
-			const bool flippedCard = game_.tableau[i].size() > 1 && !game_.tableau[i].getFromTop(1).isFaceUp(); // Check if move will reveal a tableau card.
-			return std::make_unique<Move>(Move::Tableau(c, PileID{ PileType::TABLEAU, i }, PileID{ PileType::FOUNDATION, toUType(c.getSuit()) }, 1, flippedCard));
-		}
+	if (((tableau_tops_ & safeCards) | (run_tops_ & kings)) != 0) {
+		for (u8 i = 0; i < KlondikeBoard::NUM_TABLEAU_PILES; ++i) {
+			if (!game_.tableau[i].hasCards())
+				continue;
+			// Check for a guaranteed move to the foundation.
+			if (const Card& c = game_.tableau[i].getFromTop(); _is_rule_enabled(AutoMoveRule::SAFE_FOUNDATION) && (safeCards & CardBit(c))) {
+				const bool flippedCard = game_.tableau[i].getRunLength() == 1 && game_.tableau[i].getNumFaceDown() > 0; // Check if move will reveal a tableau card.
+				return _use_auto_move(AutoMoveRule::SAFE_FOUNDATION, Move::Tableau(c, PileID{ PileType::TABLEAU, i }, PileID{ PileType::FOUNDATION, toUType(c.getSuit()) }, 1, flippedCard));
+			}
 
-		// Look for a run with a king, and see if there are enough tableau spaces to guarantee it has room.
-		u8 runLength;
-		Card topOfRun;
-		_find_top_of_run(game_.tableau[i], runLength, &topOfRun);
-		if (!game_.tableau[i][0].isFaceUp() && topOfRun.getRank() == RANK_KING) { // Don't move a king that is already on an empty spot.
-			if (u8 emptySpot{ 0 }; _has_space_for_all_kings(game_.tableau, emptySpot))
-				return std::make_unique<Move>(Move::Tableau(topOfRun, PileID{ PileType::TABLEAU, i }, PileID{ PileType::TABLEAU, emptySpot }, runLength, true));
+			// Look for a run with a king, and see if there are enough tableau spaces to guarantee it has room.
+			u8 runLength;
+			Card topOfRun;
+			_find_top_of_run(game_.tableau[i], runLength, &topOfRun);
+			if (game_.tableau[i].getNumFaceDown() > 0 && (kings & CardBit(topOfRun))) { // Don't move a king that is already on an empty spot.
+				if (u8 emptySpot{ 0 }; _has_space_for_all_kings(game_.tableau, emptySpot))
+					return _use_auto_move(AutoMoveRule::KING_TO_SPACE, Move::Tableau(topOfRun, PileID{ PileType::TABLEAU, i }, PileID{ PileType::TABLEAU, emptySpot }, runLength, true));
+			}
 		}
 	}
 	// Find auto-moves in the stock pile. There are some special cases where taking a card won't affect what stock cards are available.
-	if (!game_.stock.hasCards())
-		return nullptr;
+	if ((stock_available_ & (safeCards | kings)) == 0)
+		return std::nullopt;
 
 	const u8 stockPos = game_.getStockPosition();
 	const u8 stockSize = game_.stock.size();
 
+	if constexpr (Rules::NUM_STOCK_CARD_DRAW == 1 && Rules::REDEAL_LIMIT == UNLIMITED_REDEALS) {
+		// Every card is dealt on every pass, so taking any of them leaves the rest just as reachable.
+		if (_is_rule_enabled(AutoMoveRule::DRAW_ONE_STOCK) && (stock_available_ & safeCards)) {
+			const StockReach reach = _stock_reach();
+			for (StockPositions positions = reach.direct | reach.afterRepile; positions != 0; positions &= positions - 1) {
+				const u8 i = LowestStockPosition(positions);
+				if (const Card& c = game_.stock[i]; safeCards & CardBit(c))
+					return _use_auto_move(AutoMoveRule::DRAW_ONE_STOCK, Move::Stock(c, stockPos, i, PileID{ PileType::FOUNDATION, toUType(c.getSuit()) }, (reach.afterRepile >> i) & 1));
+			}
+		}
+	}
+
 	if (stockPos == stockSize - 1) {
 		// The last card is always a candidate as it cannot change the stock deal order.
-		return _find_guaranteed_stock_move(stockPos, game_);
+		return _find_stock_auto_move(stockPos, safeCards);
 	}
 
-	if ((stockPos + 1) % KlondikeGame::NUM_STOCK_CARD_DRAW == 0 ) { // We are in-run with our deal amount.
+	if ((stockPos + 1) % Game::NUM_STOCK_CARD_DRAW == 0 ) { // We are in-run with our deal amount.
 		// We have two possible moves that cannot change the stock deal order: second last and last, as we know by this point we are not the last card.
 		u8 secondLastStockPos = stockPos;
 		for (u8 i = game_.getNextInStock(stockPos); i < stockSize - 1; i = game_.getNextInStock(i))
 			secondLastStockPos = i;
 
-		auto move = _find_guaranteed_stock_move(secondLastStockPos, game_);
+		auto move = _find_stock_auto_move(secondLastStockPos, safeCards);
 		if (move)
 			return move;
-		return _find_guaranteed_stock_move(stockSize - 1, game_);
+		return _find_stock_auto_move(stockSize - 1, safeCards);
 	}
 
 	// Check special case if we are in the last section, but not the last card.
-	u8 cardsAtEnd = stockSize % KlondikeGame::NUM_STOCK_CARD_DRAW;
+	u8 cardsAtEnd = stockSize % Game::NUM_STOCK_CARD_DRAW;
 	if (cardsAtEnd == 0)
-		cardsAtEnd = KlondikeGame::NUM_STOCK_CARD_DRAW;
+		cardsAtEnd = Game::NUM_STOCK_CARD_DRAW;
 	if (stockSize - stockPos <= cardsAtEnd) {
 		// Can move the current card, but not the last card (because then the current card would no longer be available).
-		return _find_guaranteed_stock_move(stockPos, game_);
+		return _find_stock_auto_move(stockPos, safeCards);
 	}
 
-	return nullptr;
+	return std::nullopt;
 }
 
-void KlondikeSolver::_find_moves_to_foundation(PriorityMoveList& availableMoves) {
-	for (u8 i = 0; i < KlondikeGame::NUM_TABLEAU_PILES; ++i) {
+template <typename Rules>
+void KlondikeSolver<Rules>::_find_moves_to_foundation(PriorityMoveList& availableMoves, MoveKindSet kinds) {
+	for (u8 i = 0; i < KlondikeBoard::NUM_TABLEAU_PILES && (kinds & (_kind_bit(MoveKind::REVEAL) | _kind_bit(MoveKind::TABLEAU_TO_FOUNDATION))); ++i) {
 		if (!game_.tableau[i].hasCards())
 			continue;
 		const Card& c = game_.tableau[i].getFromTop();
-		if (_can_move_to_foundation(c, game_.foundation)) {
-			const bool flippedCard = game_.tableau[i].size() > 1 && !game_.tableau[i].getFromTop(1).isFaceUp(); // Check if move will reveal a tableau card.
-			const u32 priority = flippedCard ? toUType(Priority::REVEAL) - (game_.tableau[i].size() - 1) : toUType(Priority::TABLEAU_TO_FOUNDATION);
+		if (foundation_playable_ & CardBit(c)) {
+			const bool flippedCard = game_.tableau[i].getRunLength() == 1 && game_.tableau[i].getNumFaceDown() > 0; // Check if move will reveal a tableau card.
+			if (!(kinds & _kind_bit(flippedCard ? MoveKind::REVEAL : MoveKind::TABLEAU_TO_FOUNDATION)))
+				continue;
+			const std::int32_t priority = flippedCard ? priorities_.reveal - priorities_.revealDepthWeight * (game_.tableau[i].size() - 1) : priorities_.tableauToFoundation;
 			availableMoves.emplace_back(PriorityMove{ Move::Tableau(c, PileID{ PileType::TABLEAU, i }, PileID{ PileType::FOUNDATION, toUType(c.getSuit()) }, 1, flippedCard), priority });
 		}
 	}
-	for (u8 i = game_.getStockPosition(); i < game_.stock.size(); i = game_.getNextInStock(i)) {
+	if (!(kinds & (_kind_bit(MoveKind::STOCK) | _kind_bit(MoveKind::STOCK_AFTER_REPILE))) || !(stock_available_ & foundation_playable_))
+		return;
+	const StockReach reach = _stock_reach();
+	for (StockPositions positions = _stock_positions(reach, kinds); positions != 0; positions &= positions - 1) {
+		const u8 i = LowestStockPosition(positions);
 		const Card& c = game_.stock[i];
-		if (_can_move_to_foundation(c, game_.foundation))
-			availableMoves.emplace_back(PriorityMove{ Move::Stock(c, game_.getStockPosition(), i, PileID{ PileType::FOUNDATION, toUType(c.getSuit()) }), toUType(Priority::STOCK) - i });
+		if (foundation_playable_ & CardBit(c))
+			availableMoves.emplace_back(_stock_move(c, i, PileID{ PileType::FOUNDATION, toUType(c.getSuit()) }, reach));
 	}
 }
 
-void KlondikeSolver::_find_full_run_moves(PriorityMoveList& availableMoves) {
-	for (u8 i = 0; i < KlondikeGame::NUM_TABLEAU_PILES; ++i) {
+template <typename Rules>
+void KlondikeSolver<Rules>::_find_full_run_moves(PriorityMoveList& availableMoves, MoveKindSet kinds) {
+	// Only piles with cards to reveal, or that could be cleared for a king, can make the stage's kinds of move.
+	const bool reveals = kinds & _kind_bit(MoveKind::REVEAL);
+	const bool clears = (kinds & _kind_bit(MoveKind::CLEAR_WITH_KING)) && _is_king_available();
+	if (!reveals && !clears)
+		return;
+	u8 keys[KlondikeBoard::NUM_TABLEAU_PILES]{};
+	PileMask fromPiles = 0;
+	for (u8 i = 0; i < KlondikeBoard::NUM_TABLEAU_PILES; ++i) {
+		const Pile& pile = game_.tableau[i];
+		if (!pile.hasCards())
+			continue;
+		if (pile.getNumFaceDown() > 0 ? reveals : clears && pile[0].getRank() != RANK_KING) { // Don't move a king from one empty spot to another.
+			keys[i] = TableauKey(pile[pile.getNumFaceDown()]);
+			fromPiles |= static_cast<PileMask>(1u << i);
+		}
+	}
+	if (fromPiles == 0)
+		return;
+	// Match the top of every run against the tableau at once.
+	PileMask targets[KlondikeBoard::NUM_TABLEAU_PILES];
+	MatchTableauTargets(tableau_targets_, keys, KlondikeBoard::NUM_TABLEAU_PILES, targets);
+
+	for (; fromPiles != 0; fromPiles &= fromPiles - 1) {
+		const u8 i = LowestPile(fromPiles);
 		const Pile& fromPile = game_.tableau[i];
 		Card card;
 		u8 runLength;
-		if (!_find_top_of_run(fromPile, runLength, &card) || (runLength == fromPile.size() && card.getRank() == RANK_KING))
-			continue; // Empty pile or King in empty space.
+		_find_top_of_run(fromPile, runLength, &card);
 		// Find a place to move the card to. Only take first place if there are multiple.
 		u8 toPile;
-		if (!_find_tableau_to_tableau_move(card, game_.tableau, i, toPile))
+		if (!_find_tableau_to_tableau_move(targets[i], i, toPile))
 			continue;
-		const u32 remainingCards = game_.tableau[i].size() - runLength;
-		if (remainingCards > 0) {
-			availableMoves.emplace_back(PriorityMove{ Move::Tableau(card, PileID{ PileType::TABLEAU, i }, PileID{ PileType::TABLEAU, toPile }, runLength, true), toUType(Priority::REVEAL) - remainingCards });
-		} else if (_is_king_available()) {
-			availableMoves.emplace_back(PriorityMove{ Move::Tableau(card, PileID{ PileType::TABLEAU, i }, PileID{ PileType::TABLEAU, toPile }, runLength, false), toUType(Priority::CLEAR_WITH_KING) });
-		}
+		if (const std::int32_t remainingCards = fromPile.getNumFaceDown(); remainingCards > 0)
+			availableMoves.emplace_back(PriorityMove{ Move::Tableau(card, PileID{ PileType::TABLEAU, i }, PileID{ PileType::TABLEAU, toPile }, runLength, true), priorities_.reveal - priorities_.revealDepthWeight * remainingCards });
+		else
+			availableMoves.emplace_back(PriorityMove{ Move::Tableau(card, PileID{ PileType::TABLEAU, i }, PileID{ PileType::TABLEAU, toPile }, runLength, false), priorities_.clearWithKing });
 	}
 }
 
-void KlondikeSolver::_find_partial_run_moves(PriorityMoveList& availableMoves) {
-	for (u8 i = 0; i < KlondikeGame::NUM_TABLEAU_PILES; ++i) {
+template <typename Rules>
+void KlondikeSolver<Rules>::_find_partial_run_moves(PriorityMoveList& availableMoves, MoveKindSet kinds) {
+	if (!(kinds & _kind_bit(MoveKind::PARTIAL)))
+		return;
+	for (u8 i = 0; i < KlondikeBoard::NUM_TABLEAU_PILES; ++i) {
 		const Pile& fromPile = game_.tableau[i];
 		u8 runLength;
 		if (!_find_top_of_run(fromPile, runLength))
@@ -229,62 +354,171 @@ void KlondikeSolver::_find_partial_run_moves(PriorityMoveList& availableMoves) {
 			const Card& c = fromPile.getFromTop(k - 1); // Next card in run.
 
 			// Check if this move is in our move history. If we've already moved it, ignore this card.
-			if (std::find(partial_run_move_cards_.cbegin(), partial_run_move_cards_.cend(), c) != partial_run_move_cards_.cend())
+			if (partial_run_moved_ & CardBit(c))
 				continue;
 
 			// See if there is a spot to move this partial run to.
 			u8 toPile;
-			if (!_find_tableau_to_tableau_move(c, game_.tableau, i, toPile))
+			if (!_find_tableau_to_tableau_move(MatchTableauTargets(tableau_targets_, TableauKey(c)), i, toPile))
 				continue;
 
 			// It is a possible valid move to split up a run if:
 			// 1. The card being uncovered can be moved to the foundation.
 			// 2. There is another card that can be moved onto the uncovered card.
-			if (_can_move_to_foundation(fromPile.getFromTop(k), game_.foundation) || _is_card_available(Card(GetSameColourOtherSuit(c.getSuit()), c.getRank()))) {
-				availableMoves.emplace_back(PriorityMove{ Move::TableauPartial(c, PileID{ PileType::TABLEAU, i }, PileID{ PileType::TABLEAU, toPile }, k), toUType(Priority::PARTIAL) });
+			if ((foundation_playable_ & CardBit(fromPile.getFromTop(k))) || _is_card_available(Card(GetSameColourOtherSuit(c.getSuit()), c.getRank()))) {
+				availableMoves.emplace_back(PriorityMove{ Move::TableauPartial(c, PileID{ PileType::TABLEAU, i }, PileID{ PileType::TABLEAU, toPile }, k), priorities_.partial });
 			}
 		}
 	}
 }
 
-void KlondikeSolver::_find_stock_to_tableau_moves(PriorityMoveList& availableMoves) {
-	for (u8 i = game_.getStockPosition(); i < game_.stock.size(); i = game_.getNextInStock(i)) {
-		const Card& c = game_.stock[i];
-		for (u8 k = 0; k < KlondikeGame::NUM_TABLEAU_PILES; ++k) {
-			if (!game_.tableau[k].hasCards()) {
-				if (c.getRank() == RANK_KING) // Move king down to empty spot.
-					availableMoves.emplace_back(PriorityMove{ Move::Stock(c, game_.getStockPosition(), i, PileID{ PileType::TABLEAU, k }), toUType(Priority::STOCK) - i });
-			} else if (_can_place_card(c, game_.tableau[k].getFromTop())) { // Place card on a tableau pile.
-				availableMoves.emplace_back(PriorityMove{ Move::Stock(c, game_.getStockPosition(), i, PileID{ PileType::TABLEAU, k }), toUType(Priority::STOCK) - i });
-			}
+template <typename Rules>
+void KlondikeSolver<Rules>::_find_stock_to_tableau_moves(PriorityMoveList& availableMoves, MoveKindSet kinds) {
+	if (!(kinds & (_kind_bit(MoveKind::STOCK) | _kind_bit(MoveKind::STOCK_AFTER_REPILE))))
+		return;
+	const StockReach reach = _stock_reach();
+	StockPositions reachable = _stock_positions(reach, kinds);
+	if (reachable == 0)
+		return;
+	// Match every reachable stock card against the tableau at once.
+	u8 positions[Game::MAX_STOCK_SIZE];
+	u8 keys[Game::MAX_STOCK_SIZE]{};
+	u8 count = 0;
+	for (; reachable != 0; reachable &= reachable - 1) {
+		positions[count] = LowestStockPosition(reachable);
+		keys[count] = TableauKey(game_.stock[positions[count]]);
+		++count;
+	}
+	PileMask targets[Game::MAX_STOCK_SIZE];
+	MatchTableauTargets(tableau_targets_, keys, count, targets);
+
+	for (u8 n = 0; n < count; ++n) {
+		const u8 i = positions[n];
+		for (PileMask piles = targets[n]; piles != 0; piles &= piles - 1) // Kings only match empty spots.
+			availableMoves.emplace_back(_stock_move(game_.stock[i], i, PileID{ PileType::TABLEAU, LowestPile(piles) }, reach));
+	}
+}
+
+template <typename Rules>
+typename KlondikeSolver<Rules>::StockPositions KlondikeSolver<Rules>::_stock_positions(const StockReach& reach, MoveKindSet kinds) {
+	return ((kinds & _kind_bit(MoveKind::STOCK)) ? reach.direct : 0) | ((kinds & _kind_bit(MoveKind::STOCK_AFTER_REPILE)) ? reach.afterRepile : 0);
+}
+
+template <typename Rules>
+typename KlondikeSolver<Rules>::PriorityMove KlondikeSolver<Rules>::_stock_move(const Card& card, u8 stockPosition, PileID toPile, const StockReach& reach) const {
+	// Cards only reachable by repiling are tried where the repile itself used to be.
+	const bool repileFirst = (reach.afterRepile >> stockPosition) & 1;
+	const std::int32_t priority = (repileFirst ? priorities_.repileStock : priorities_.stock) - priorities_.stockPositionWeight * stockPosition;
+	return PriorityMove{ Move::Stock(card, game_.getStockPosition(), stockPosition, toPile, repileFirst), priority };
+}
+
+template <typename Rules>
+MoveList KlondikeSolver<Rules>::_expand_stock_moves(const MoveList& moves) const {
+	// Only stock moves change the stock's size, so work back to its size before the moves.
+	u8 stockSize = game_.stock.size();
+	for (const Move& m : moves)
+		stockSize += m.getType() == MoveType::STOCK;
+	MoveList expanded;
+	expanded.reserve(moves.size());
+	for (const Move& m : moves) {
+		if (m.getType() == MoveType::STOCK && m.repilesStockFirst()) {
+			expanded.push_back(Move::RepileStock(m.getCurrentStockPosition()));
+			expanded.push_back(Move::Stock(m.getMovedCard(), Game::getStockStartPosition(stockSize), m.getStockMovePosition(), m.getToPile()));
+		} else {
+			expanded.push_back(m);
 		}
+		stockSize -= m.getType() == MoveType::STOCK;
 	}
+	return expanded;
 }
 
-KlondikeSolver::PriorityMoveList KlondikeSolver::_find_available_moves() {
-	PriorityMoveList moves;
-	_find_full_run_moves(moves);
-	_find_partial_run_moves(moves);
-	_find_stock_to_tableau_moves(moves);
-	_find_moves_to_foundation(moves);
+template <typename Rules>
+void KlondikeSolver<Rules>::_find_foundation_to_tableau_moves(PriorityMoveList& availableMoves, MoveKindSet kinds) {
+	if (!(kinds & _kind_bit(MoveKind::FOUNDATION_TO_TABLEAU)))
+		return;
+	for (u8 i = 0; i < KlondikeBoard::NUM_FOUNDATION_PILES; ++i) {
+		if (!game_.foundation[i].hasCards())
+			continue;
+		const Card& c = game_.foundation[i].getFromTop();
+		if (_is_rule_enabled(AutoMoveRule::SAFE_FOUNDATION) && (_safe_foundation_cards() & CardBit(c)))
+			continue; // Would just be auto-moved straight back.
+		u8 toPile;
+		if (_find_tableau_to_tableau_move(MatchTableauTargets(tableau_targets_, TableauKey(c)), KlondikeBoard::NUM_TABLEAU_PILES, toPile))
+			availableMoves.emplace_back(PriorityMove{ Move::Tableau(c, PileID{ PileType::FOUNDATION, i }, PileID{ PileType::TABLEAU, toPile }, 1, false), priorities_.foundationToTableau });
+	}
+}
 
-	if (game_.isStockDirty()) // If we can shuffle the stock, do so last.
-		moves.emplace_back(PriorityMove{ Move::RepileStock(game_.getStockPosition()), toUType(Priority::REPILE_STOCK) });
+template <typename Rules>
+void KlondikeSolver<Rules>::_plan_move_stages() {
+	struct Range {
+		std::int32_t low, high;
+		MoveKindSet kinds;
+	};
+	// Priorities of a kind of move are its base, less its weight times a number of steps (EG face-down cards, or stock positions).
+	auto range = [](MoveKind kind, std::int32_t base, std::int32_t weight, std::int32_t maxSteps) {
+		const std::int32_t first = base, last = base - weight * maxSteps;
+		return Range{ std::min(first, last), std::max(first, last), _kind_bit(kind) };
+	};
+	// Kinds found by the same pass over the board share a stage, so the pass isn't made twice for a position.
+	auto join = [](const Range& lhs, const Range& rhs) {
+		return Range{ std::min(lhs.low, rhs.low), std::max(lhs.high, rhs.high), static_cast<MoveKindSet>(lhs.kinds | rhs.kinds) };
+	};
+	constexpr std::int32_t maxFaceDown = KlondikeBoard::NUM_TABLEAU_PILES - 1;
+	constexpr std::int32_t lastStock = KlondikeBoard::MAX_STOCK_SIZE - 1;
+	Range ranges[] = {
+		// Reveals flip at least one card, so start a step in.
+		join(range(MoveKind::REVEAL, priorities_.reveal - priorities_.revealDepthWeight, priorities_.revealDepthWeight, maxFaceDown - 1),
+			range(MoveKind::CLEAR_WITH_KING, priorities_.clearWithKing, 0, 0)),
+		join(range(MoveKind::STOCK, priorities_.stock, priorities_.stockPositionWeight, lastStock),
+			range(MoveKind::STOCK_AFTER_REPILE, priorities_.repileStock, priorities_.stockPositionWeight, lastStock)),
+		range(MoveKind::TABLEAU_TO_FOUNDATION, priorities_.tableauToFoundation, 0, 0),
+		range(MoveKind::PARTIAL, priorities_.partial, 0, 0),
+		range(MoveKind::FOUNDATION_TO_TABLEAU, priorities_.foundationToTableau, 0, 0),
+	};
+	std::stable_sort(std::begin(ranges), std::end(ranges), [](const Range& lhs, const Range& rhs) { return lhs.low < rhs.low; });
 
-	std::sort(moves.begin(), moves.end(), [](const auto& lhs, const auto& rhs) { return lhs.priority < rhs.priority; });
-	return moves;
+	// Kinds with overlapping priorities also share a stage, so that moves are still tried in priority order.
+	num_move_stages_ = 0;
+	std::int32_t stageHigh = 0;
+	for (const Range& r : ranges) {
+		if (!Rules::FOUNDATION_TO_TABLEAU && r.kinds == _kind_bit(MoveKind::FOUNDATION_TO_TABLEAU))
+			continue; // Never generated.
+		if (num_move_stages_ == 0 || r.low > stageHigh) {
+			move_stages_[num_move_stages_++] = 0;
+			stageHigh = r.high;
+		}
+		move_stages_[num_move_stages_ - 1] |= r.kinds;
+		stageHigh = std::max(stageHigh, r.high);
+	}
 }
 
-bool KlondikeSolver::_is_seen_state() {
-	if (!move_sequence_.empty() && move_sequence_.back().type == MoveType::REPILE_STOCK)
-		return false; // Don't bother storing new state on repile stock moves.
+template <typename Rules>
+bool KlondikeSolver<Rules>::_find_next_stage_moves(SearchFrame& frame) {
+	if (frame.stage == num_move_stages_)
+		return false;
+	const MoveKindSet kinds = move_stages_[frame.stage++];
+	PriorityMoveList& moves = frame.moves;
+	const std::size_t first = moves.size();
+	_find_full_run_moves(moves, kinds);
+	_find_partial_run_moves(moves, kinds);
+	_find_stock_to_tableau_moves(moves, kinds);
+	_find_moves_to_foundation(moves, kinds);
+	if constexpr (Rules::FOUNDATION_TO_TABLEAU)
+		_find_foundation_to_tableau_moves(moves, kinds);
+
+	// Ties are tried in the order they were found.
+	_sort_by_priority(moves.begin() + first, moves.end());
+	return true;
+}
 
+template <typename Rules>
+void KlondikeSolver<Rules>::_get_state_key(StateTable::Key& out_key) const {
 	// Build a unique ID for the deck, using the series of all its cards.
 	// Each card takes a value of [0,51], meaning they fit in the space of 6 bits.
 	// This means the unique ID for a full deck can be packed into a 39 char string,
 	// plus 12 chars for pile separators and the stock position, for a total of 48.
-	std::string uniqueId;
-	uniqueId.resize(UNIQUE_STATE_SIZE, 0);
+	StateTable::Key& uniqueId = out_key;
+	uniqueId = {};
 
 	u8 offset = 0;
 	u8 index = 0;
@@ -317,128 +551,530 @@ bool KlondikeSolver::_is_seen_state() {
 		pack_bits(pileSeparator);
 	}
 	pack_pile_bits(game_.stock);
-	pack_bits(game_.getStockPosition());
+	pack_bits(game_.getCanonicalStockPosition());
+	if constexpr (Rules::REDEAL_LIMIT != UNLIMITED_REDEALS)
+		pack_bits(game_.getRedeals());
+}
 
-	return !seen_states_.insert(uniqueId).second;
+template <typename Rules>
+typename KlondikeSolver<Rules>::StateCheck KlondikeSolver<Rules>::_check_state(StateTable::Key& out_key) {
+	_get_state_key(out_key);
+	if (hinting_ && lost_states_.contains(out_key))
+		return StateCheck::LOST;
+	if (state_store_)
+		return state_store_->insert(out_key) ? StateCheck::NEW : StateCheck::SEEN;
+	if (state_filter_.isEnabled())
+		return state_filter_.insert(out_key) ? StateCheck::NEW : StateCheck::SEEN;
+	return seen_states_.insert(out_key) ? StateCheck::NEW : StateCheck::SEEN;
 }
 
-void KlondikeSolver::_init() {
+template <typename Rules>
+void KlondikeSolver<Rules>::_init() {
 	states_tried_ = 0;
+	auto_move_counts_ = {};
+	endgame_counts_ = {};
+	sleeping_moves_skipped_ = 0;
+	searching_ = false;
+	search_depth_ = 0;
 	seen_states_.clear();
+	state_filter_.clear();
 	move_sequence_.clear();
-	partial_run_move_cards_.clear();
-	seen_states_.reserve( static_cast<unsigned int>(maxStates == 0 ? 10'000'000 : std::min(maxStates, static_cast<u64>(seen_states_.max_size()))));
+	_rebuild_card_masks();
 }
 
-GameResult::Result KlondikeSolver::_solve_recursive(u32 depth) {
-	if (_is_seen_state())
-		return GameResult::Result::LOSE;
-
-	MoveList autoMoves;
-	while (std::unique_ptr<Move> m = _find_auto_move()) {
-		autoMoves.push_back(*m.get());
-		_do_move(*m.get());
+template <typename Rules>
+bool KlondikeSolver<Rules>::_is_endgame() const {
+	for (const Pile& pile : game_.tableau) {
+		if (pile.getNumFaceDown() > 0)
+			return false;
 	}
+	return true;
+}
 
-	if (game_.isGameWon())
-		return GameResult::Result::WIN;
+template <typename Rules>
+bool KlondikeSolver<Rules>::_play_out_endgame() {
+	++endgame_counts_.attempts;
+	const std::size_t start = move_sequence_.size();
+	bool repiled = false; // Stop if a repile doesn't lead to a move, or the stock would cycle forever.
+	auto findMove = [this]() -> std::optional<Move> {
+		for (u8 i = 0; i < KlondikeBoard::NUM_TABLEAU_PILES; ++i) {
+			if (game_.tableau[i].hasCards() && (foundation_playable_ & CardBit(game_.tableau[i].getFromTop()))) {
+				const Card& c = game_.tableau[i].getFromTop();
+				return Move::Tableau(c, PileID{ PileType::TABLEAU, i }, PileID{ PileType::FOUNDATION, toUType(c.getSuit()) }, 1, false);
+			}
+		}
+		if (!(stock_available_ & foundation_playable_))
+			return std::nullopt;
+		for (u8 i = game_.getStockPosition(); i < game_.stock.size(); i = game_.getNextInStock(i)) {
+			if (const Card& c = game_.stock[i]; foundation_playable_ & CardBit(c))
+				return Move::Stock(c, game_.getStockPosition(), i, PileID{ PileType::FOUNDATION, toUType(c.getSuit()) });
+		}
+		return std::nullopt;
+	};
+	while (!game_.isGameWon()) {
+		if (std::optional<Move> m = findMove()) {
+			_do_move(*m);
+			repiled = false;
+		} else if (!repiled && game_.isStockDirty() && game_.canRedealStock()) {
+			_do_move(Move::RepileStock(game_.getStockPosition()));
+			repiled = true;
+		} else {
+			while (move_sequence_.size() > start) {
+				const Move m = move_sequence_.back();
+				_undo_move(m);
+			}
+			return false;
+		}
+	}
+	++endgame_counts_.playOuts;
+	endgame_counts_.moves += move_sequence_.size() - start;
+	return true;
+}
 
-	if (states_tried_ != 0 && maxStates != 0 && states_tried_ >= maxStates)
-		return GameResult::Result::UNKNOWN; // Ran out of allowed states to try.
+template <typename Rules>
+std::optional<GameResult::Result> KlondikeSolver<Rules>::_enter_position() {
+	// Frames are reused, so their move lists keep their memory from position to position.
+	if (search_depth_ == search_stack_.size())
+		search_stack_.emplace_back();
+	SearchFrame& frame = search_stack_[search_depth_];
+	const StateCheck check = _check_state(frame.key);
+	if (check == StateCheck::SEEN || check == StateCheck::LOST) {
+		// Seen states may still be on the search path, so the parent's loss can't be proven without them.
+		if (check == StateCheck::SEEN && search_depth_ > 0)
+			search_stack_[search_depth_ - 1].unproven = true;
+		return GameResult::Result::LOSE;
+	}
+	MoveList& autoMoves = frame.autoMoves;
+	PriorityMoveList& moves = frame.moves;
+	autoMoves.clear();
+	moves.clear();
+	frame.next = 0;
+	frame.sleep.clear();
+	if (search_depth_ > 0)
+		_inherit_sleep_set(search_stack_[search_depth_ - 1], frame);
+	frame.unproven = false;
+	for (;;) {
+		while (std::optional<Move> m = _find_auto_move()) {
+			autoMoves.push_back(*m);
+			_do_move(*m);
+		}
 
-	if (PriorityMoveList moves = _find_available_moves(); !moves.empty()) {
-		for (const auto& priMove : moves) {
-			_do_move(priMove.move);
-			++states_tried_;
+		if (game_.isGameWon())
+			return GameResult::Result::WIN;
 
-			if (false)
-				game_.printGame();
+		if (_is_endgame() && _play_out_endgame())
+			return GameResult::Result::WIN;
 
-			if (auto result = _solve_recursive(depth + 1); result != GameResult::Result::LOSE)
-				return result;
+		if (states_tried_ != 0 && maxStates != 0 && states_tried_ >= maxStates)
+			return GameResult::Result::UNKNOWN; // Ran out of allowed states to try.
+		if (state_filter_.isEnabled() && state_filter_.isFull())
+			return GameResult::Result::UNKNOWN; // Going on would raise the filter's false positive rate past what it was sized for.
 
-			_undo_move(priMove.move);
+		// Moves are found a stage at a time, as the search gets to them. A forced move needs to know there are no others, though.
+		moves.clear();
+		frame.stage = 0;
+		while (moves.empty() && _find_next_stage_moves(frame)) {}
+		if (_is_rule_enabled(AutoMoveRule::FORCED_MOVE)) {
+			while (moves.size() == 1 && _find_next_stage_moves(frame)) {}
+		}
+		// With only one way forward, take it as an auto-move (unless it could be undone, and cycle back).
+		if (moves.size() != 1 || !_is_rule_enabled(AutoMoveRule::FORCED_MOVE) || moves.front().move.getFromPile().type == PileType::FOUNDATION)
+			break;
+		autoMoves.push_back(_use_auto_move(AutoMoveRule::FORCED_MOVE, moves.front().move).value());
+		_do_move(autoMoves.back());
+		// Forced moves can still lead back round to a known state (EG by cycling the stock).
+		StateTable::Key key;
+		if (const StateCheck forced = _check_state(key); forced == StateCheck::SEEN || forced == StateCheck::LOST) {
+			frame.unproven |= forced == StateCheck::SEEN;
+			moves.clear();
+			frame.stage = num_move_stages_;
+			break;
 		}
 	}
+	// Moves already sleeping only stay asleep if they commute with everything played since.
+	if (!frame.sleep.empty() && !autoMoves.empty()) {
+		frame.sleep.erase(std::remove_if(frame.sleep.begin(), frame.sleep.end(), [&autoMoves](const Move& s) {
+			return std::any_of(autoMoves.begin(), autoMoves.end(), [&s](const Move& m) { return !_are_independent(s, m); });
+		}), frame.sleep.end());
+	}
+	++search_depth_;
+	return std::nullopt;
+}
 
-	for (std::size_t i = autoMoves.size(); i != 0; )
-		_undo_move(autoMoves[--i]);
-
-	return GameResult::Result::LOSE;
+template <typename Rules>
+void KlondikeSolver<Rules>::_inherit_sleep_set(const SearchFrame& parent, SearchFrame& child) const {
+	// Moves the parent has already searched, or that were asleep there, lead to positions that are reached again by playing them
+	// after this move, if they're independent of it. So they don't need trying from the child.
+	const Move move = parent.moves[parent.next - 1].move;
+	if (move.getType() != MoveType::TABLEAU || move.getFromPile().type != PileType::TABLEAU)
+		return; // Nothing's independent of it.
+	for (const Move& s : parent.sleep) {
+		if (_are_independent(s, move))
+			child.sleep.push_back(s);
+	}
+	for (std::size_t i = 0; i + 1 < parent.next; ++i) {
+		const Move& s = parent.moves[i].move;
+		if (_are_independent(s, move) && std::find(parent.sleep.begin(), parent.sleep.end(), s) == parent.sleep.end())
+			child.sleep.push_back(s);
+	}
 }
 
-void KlondikeSolver::_do_move(const Move& m) {
+template <typename Rules>
+void KlondikeSolver<Rules>::_do_move(const Move& m) {
 	move_sequence_.push_back(m);
-	if (m.type == MoveType::TABLEAU_PARTIAL)
-		partial_run_move_cards_.push_back(m.movedCard);
+	if (m.getType() == MoveType::TABLEAU_PARTIAL)
+		partial_run_moved_ |= CardBit(m.getMovedCard());
+	_toggle_pile_masks(m.getFromPile());
+	_toggle_pile_masks(m.getToPile());
 	KlondikeSolver::doMove(game_, m);
+	_toggle_pile_masks(m.getFromPile());
+	_toggle_pile_masks(m.getToPile());
+	if (m.getType() == MoveType::STOCK || m.getType() == MoveType::REPILE_STOCK)
+		_update_stock_mask();
 }
 
-void KlondikeSolver::_undo_move(const Move& m) {
+template <typename Rules>
+void KlondikeSolver<Rules>::_undo_move(const Move& m) {
 	move_sequence_.pop_back();
-	switch (m.type) {
+	_toggle_pile_masks(m.getFromPile());
+	_toggle_pile_masks(m.getToPile());
+	switch (m.getType()) {
 	case MoveType::TABLEAU_PARTIAL:
-	{
-		auto position = std::find(partial_run_move_cards_.begin(), partial_run_move_cards_.end(), m.movedCard);
-		if (position != partial_run_move_cards_.end())
-			partial_run_move_cards_.erase(position);
+		if (partial_run_moved_ & CardBit(m.getMovedCard()))
+			partial_run_moved_ &= ~CardBit(m.getMovedCard());
 		else
 			std::cerr << "Error (_undo_move): Failed to find partial run move to erase!\n";
-	}
 		[[fallthrough]];
 	case MoveType::TABLEAU: // Move one or several cards back from one pile to another.
-		if (m.flippedCard) // If we flipped a card, turn it back over first.
-			game_.getPile(m.fromPile).getFromTop().flipCard();
-		Pile::MoveCards(game_.getPile(m.toPile), game_.getPile(m.fromPile), m.cardsToMove);
+		if (m.hasFlippedCard()) // If we flipped a card, turn it back over first.
+			game_.getPile(m.getFromPile()).flipTopCard();
+		Pile::MoveCards(game_.getPile(m.getToPile()), game_.getPile(m.getFromPile()), m.getCardsToMove());
 		break;
 	case MoveType::STOCK: // Move one card from the end of a tableau or foundation pile back to the stock pile.
-		Pile::MoveCard(game_.getPile(m.toPile), -1, game_.getPile(m.fromPile), m.stockMovePosition);
-		[[fallthrough]];
+		Pile::MoveCard(game_.getPile(m.getToPile()), -1, game_.getPile(m.getFromPile()), m.getStockMovePosition());
+		if (m.repilesStockFirst())
+			game_.undoRedealStock(m.getCurrentStockPosition());
+		else
+			game_.setStockPosition(m.getCurrentStockPosition());
+		break;
 	case MoveType::REPILE_STOCK: // Undo stock repile by moving the stock position back to its previous position.
-		game_.setStockPosition(m.currentStockPosition);
+		game_.undoRedealStock(m.getCurrentStockPosition());
 		break;
 	}
+	_toggle_pile_masks(m.getFromPile());
+	_toggle_pile_masks(m.getToPile());
+	if (m.getType() == MoveType::STOCK || m.getType() == MoveType::REPILE_STOCK)
+		_update_stock_mask();
 }
 
-GameResult KlondikeSolver::solve() {
-	u32 depth = 0;
-	GameResult::Result r = _solve_recursive(depth);
+template <typename Rules>
+GameResult KlondikeSolver<Rules>::solve() {
+	return *solveFor(0);
+}
 
-	if (r == GameResult::Result::UNKNOWN || r == GameResult::Result::LOSE)
+template <typename Rules>
+std::optional<GameResult> KlondikeSolver<Rules>::solveFor(u64 sliceStates) {
+	auto finish = [this](GameResult::Result r) {
+		searching_ = false;
+		search_depth_ = 0;
+		MoveList solution;
+		if (r == GameResult::Result::WIN)
+			solution = _expand_stock_moves(move_sequence_);
 		move_sequence_.clear();
+		return GameResult{ states_tried_, game_.getSeed(), std::move(solution), r, auto_move_counts_, endgame_counts_, sleeping_moves_skipped_, state_filter_.isEnabled() };
+	};
 
-	return GameResult{ states_tried_, game_.getSeed(), move_sequence_, r };
+	if (!searching_) {
+		searching_ = true;
+		if (std::optional<GameResult::Result> r = _enter_position())
+			return finish(*r);
+	}
+
+	// Depth first search, with the path kept on the search stack rather than the call stack, so it can stop and pick up again.
+	const u64 sliceEnd = sliceStates == 0 ? 0 : states_tried_ + sliceStates;
+	while (search_depth_ > 0) {
+		SearchFrame& frame = search_stack_[search_depth_ - 1];
+		if (frame.next < frame.moves.size() || _find_next_stage_moves(frame)) {
+			if (frame.next == frame.moves.size())
+				continue; // The stage had no moves.
+			if (sliceEnd != 0 && states_tried_ >= sliceEnd)
+				return std::nullopt; // Yield before trying the next position.
+			const Move move = frame.moves[frame.next++].move;
+			if (!frame.sleep.empty() && std::find(frame.sleep.begin(), frame.sleep.end(), move) != frame.sleep.end()) {
+				++sleeping_moves_skipped_;
+				frame.unproven = true; // Its position is searched from another path, so a loss here also rests on that search.
+				continue;
+			}
+			_do_move(move);
+			++states_tried_;
+			if (std::optional<GameResult::Result> r = _enter_position()) {
+				if (*r != GameResult::Result::LOSE)
+					return finish(*r);
+				_undo_move(move);
+			}
+			continue;
+		}
+
+		// Every move from this position has failed. Back out of it, then undo the move that led to it.
+		// Unless the search cut a cycle back to the search path, the position is lost, whatever the path to it.
+		if (hinting_ && (!frame.unproven || search_depth_ == 1))
+			lost_states_.insert(frame.key);
+		for (std::size_t i = frame.autoMoves.size(); i != 0; )
+			_undo_move(frame.autoMoves[--i]);
+		const bool unproven = frame.unproven;
+		if (--search_depth_ > 0) {
+			SearchFrame& parent = search_stack_[search_depth_ - 1];
+			parent.unproven |= unproven;
+			_undo_move(parent.moves[parent.next - 1].move);
+		}
+	}
+	return finish(GameResult::Result::LOSE);
 }
 
-void KlondikeSolver::setSeed(u64 seed) {
-	game_ = KlondikeGame(seed);
+template <typename Rules>
+void KlondikeSolver<Rules>::setSeed(u64 seed) {
+	game_ = Game(seed);
 	game_.setUpGame();
+	hinting_ = false;
 	_init();
 }
 
-void KlondikeSolver::setGame(const KlondikeGame& game) {
+template <typename Rules>
+void KlondikeSolver<Rules>::setGame(const Game& game) {
 	game_ = game;
+	hinting_ = false;
 	_init();
 }
 
-void KlondikeSolver::doMove(KlondikeGame& game, const Move& m) {
-	switch (m.type) {
+template <typename Rules>
+bool KlondikeSolver<Rules>::writeCheckpoint(std::ostream& out) const {
+	if (!searching_)
+		return false;
+	CheckpointHeader header;
+	header.rules = _checkpoint_rules<Rules>();
+	_write_value(out, header);
+	_write_value(out, game_.getSeed());
+	_write_value(out, states_tried_);
+	_write_value(out, auto_move_counts_);
+	_write_value(out, endgame_counts_);
+	_write_value(out, sleeping_moves_skipped_);
+	_write_moves(out, move_sequence_);
+	_write_value(out, search_depth_);
+	for (u32 i = 0; i < search_depth_; ++i) {
+		const SearchFrame& frame = search_stack_[i];
+		_write_moves(out, frame.autoMoves);
+		_write_value(out, static_cast<u64>(frame.moves.size()));
+		for (const PriorityMove& move : frame.moves) {
+			_write_value(out, move.move.getCode());
+			_write_value(out, move.priority);
+		}
+		_write_value(out, static_cast<u64>(frame.next));
+		_write_value(out, frame.stage);
+		_write_value(out, frame.key);
+		_write_moves(out, frame.sleep);
+		_write_value(out, static_cast<u8>(frame.unproven));
+	}
+	return static_cast<bool>(out);
+}
+
+template <typename Rules>
+bool KlondikeSolver<Rules>::readCheckpoint(std::istream& in) {
+	CheckpointHeader header, expected;
+	expected.rules = _checkpoint_rules<Rules>();
+	u64 seed;
+	if (!_read_value(in, header) || std::memcmp(&header, &expected, sizeof(header)) != 0 || !_read_value(in, seed)) {
+		std::cerr << "KlondikeSolver::readCheckpoint: Checkpoint is for other rules or another solver version.\n";
+		return false;
+	}
+	setSeed(seed);
+	// Replay the path to the deepest position, then put the frames back over it.
+	MoveList path;
+	bool valid = _read_value(in, states_tried_) && _read_value(in, auto_move_counts_) && _read_value(in, endgame_counts_)
+		&& _read_value(in, sleeping_moves_skipped_) && _read_moves(in, path);
+	for (std::size_t i = 0; valid && i < path.size(); ++i) {
+		valid = isMoveLegal(game_, path[i]);
+		if (valid)
+			_do_move(path[i]);
+	}
+	u32 depth = 0;
+	valid = valid && _read_value(in, depth) && depth <= path.size() + 1;
+	if (valid && search_stack_.size() < depth)
+		search_stack_.resize(depth);
+	for (u32 i = 0; valid && i < depth; ++i) {
+		SearchFrame& frame = search_stack_[i];
+		u64 numMoves = 0, next = 0;
+		valid = _read_moves(in, frame.autoMoves) && _read_value(in, numMoves) && numMoves <= (1u << 16);
+		frame.moves.resize(valid ? numMoves : 0);
+		for (PriorityMove& move : frame.moves) {
+			std::uint32_t code = 0;
+			valid = valid && _read_value(in, code) && _read_value(in, move.priority);
+			move.move = Move::FromCode(code);
+		}
+		u8 unproven = 0;
+		valid = valid && _read_value(in, next) && next <= frame.moves.size() && _read_value(in, frame.stage) && _read_value(in, frame.key)
+			&& _read_moves(in, frame.sleep) && _read_value(in, unproven);
+		frame.next = static_cast<std::size_t>(next);
+		frame.unproven = unproven != 0;
+	}
+	if (!valid) {
+		std::cerr << "KlondikeSolver::readCheckpoint: Checkpoint is incomplete, or its moves don't fit seed " << seed << ".\n";
+		setSeed(seed);
+		return false;
+	}
+	search_depth_ = depth;
+	searching_ = true;
+	return true;
+}
+
+template <typename Rules>
+void KlondikeSolver<Rules>::startHints(const Game& game) {
+	setGame(game);
+	hinting_ = true;
+	hint_root_ = game;
+	hint_line_.clear();
+	lost_states_.clear();
+}
+
+template <typename Rules>
+bool KlondikeSolver<Rules>::playHintMove(const Move& move) {
+	if (!hinting_ || !tryDoMove(hint_root_, move))
+		return false;
+	// Stay on the winning line if the move follows it. Otherwise it has to be searched for again (but lost states are still lost).
+	if (!hint_line_.empty() && hint_line_.front() == move)
+		hint_line_.erase(hint_line_.begin());
+	else
+		hint_line_.clear();
+	searching_ = false; // Drop any search still open from the old root.
+	return true;
+}
+
+template <typename Rules>
+Hint KlondikeSolver<Rules>::hint(std::chrono::microseconds budget) {
+	const auto deadline = std::chrono::steady_clock::now() + budget;
+	if (!hinting_)
+		return Hint{ std::nullopt, GameResult::Result::UNKNOWN, {}, 0 };
+	if (!hint_line_.empty() || hint_root_.isGameWon())
+		return Hint{ hint_line_.empty() ? std::nullopt : std::optional<Move>(hint_line_.front()), GameResult::Result::WIN, hint_line_, 0 };
+
+	// Pick up the last search if it ran out of time on this same position.
+	if (!searching_) {
+		game_ = hint_root_;
+		_init();
+	}
+	MoveList line; // Best line so far: the path being searched.
+	for (;;) {
+		std::optional<GameResult> result = solveFor(HINT_SLICE_STATES);
+		if (result) {
+			if (result->result == GameResult::Result::WIN)
+				hint_line_ = result->solution;
+			else if (result->result == GameResult::Result::LOSE)
+				line.clear();
+			const MoveList& best = result->result == GameResult::Result::WIN ? hint_line_ : line;
+			return Hint{ best.empty() ? std::nullopt : std::optional<Move>(best.front()), result->result, best, result->positionsTried };
+		}
+		line = _expand_stock_moves(move_sequence_);
+		if (std::chrono::steady_clock::now() >= deadline)
+			return Hint{ line.empty() ? std::nullopt : std::optional<Move>(line.front()), GameResult::Result::UNKNOWN, line, states_tried_ };
+	}
+}
+
+template <typename Rules>
+void KlondikeSolver<Rules>::doMove(Game& game, const Move& m) {
+	switch (m.getType()) {
 	case MoveType::TABLEAU_PARTIAL:
 		[[fallthrough]];
 	case MoveType::TABLEAU: // Move one or several cards from one pile to another.
-		Pile::MoveCards(game.getPile(m.fromPile), game.getPile(m.toPile), m.cardsToMove);
-		if (m.flippedCard) // Reveal an uncovered card.
-			game.getPile(m.fromPile).getFromTop().flipCard();
+		Pile::MoveCards(game.getPile(m.getFromPile()), game.getPile(m.getToPile()), m.getCardsToMove());
+		if (m.hasFlippedCard()) // Reveal an uncovered card.
+			game.getPile(m.getFromPile()).flipTopCard();
 		break;
 	case MoveType::STOCK: // Move one card from stock to a tableau or foundation pile.
-		Pile::MoveCard(game.getPile(m.fromPile), m.stockMovePosition, game.getPile(m.toPile));
-		if (m.stockMovePosition != 0)
-			game.setStockPosition(m.stockMovePosition - 1); // Move to previous card (now made visible).
+		if (m.repilesStockFirst())
+			game.redealStock();
+		Pile::MoveCard(game.getPile(m.getFromPile()), m.getStockMovePosition(), game.getPile(m.getToPile()));
+		if (m.getStockMovePosition() != 0)
+			game.setStockPosition(m.getStockMovePosition() - 1); // Move to previous card (now made visible).
 		else
 			game.repileStock(); // We've used up all the "waste" cards. Need to re-pile or we wouldn't be looking at a card anymore.
 		break;
 	case MoveType::REPILE_STOCK: // Shuffle the stock, resetting the stock position.
-		game.repileStock();
+		game.redealStock();
 		break;
 	}
 }
+
+template <typename Rules>
+bool KlondikeSolver<Rules>::isMoveLegal(const Game& game, const Move& m) {
+	const PileID from = m.getFromPile();
+	const PileID to = m.getToPile();
+	auto validPile = [](const PileID& id) {
+		switch (id.type) {
+		case PileType::TABLEAU:    return id.index < KlondikeBoard::NUM_TABLEAU_PILES;
+		case PileType::FOUNDATION: return id.index < KlondikeBoard::NUM_FOUNDATION_PILES;
+		case PileType::STOCK:      return true;
+		default:                   return false;
+		}
+	};
+	// Check the moved card can go on the destination pile.
+	auto canPlace = [&game, &to](const Card& card, u8 count) {
+		const Pile& toPile = game.getPile(to);
+		if (to.type == PileType::FOUNDATION)
+			return count == 1 && to.index == toUType(card.getSuit()) && card.getRank() == toPile.size() + 1;
+		if (to.type != PileType::TABLEAU)
+			return false;
+		return toPile.hasCards() ? _can_place_card(card, toPile.getFromTop()) : card.getRank() == RANK_KING;
+	};
+
+	switch (m.getType()) {
+	case MoveType::TABLEAU_PARTIAL:
+		[[fallthrough]];
+	case MoveType::TABLEAU: {
+		if (!validPile(from) || !validPile(to) || (from.type == to.type && from.index == to.index))
+			return false;
+		const Pile& fromPile = game.getPile(from);
+		const u8 count = m.getCardsToMove();
+		if (from.type == PileType::FOUNDATION) {
+			if (!Rules::FOUNDATION_TO_TABLEAU || to.type != PileType::TABLEAU || count != 1 || m.hasFlippedCard() || !fromPile.hasCards())
+				return false;
+		} else if (from.type != PileType::TABLEAU || count == 0 || count > fromPile.getRunLength()) {
+			return false; // Can only move face-up cards.
+		}
+		const Card& card = fromPile.getFromTop(count - 1);
+		if (!(card == m.getMovedCard()))
+			return false;
+		// A partial run leaves face-up cards behind, and any other move from the tableau reveals a card if there is one.
+		const bool revealsCard = from.type == PileType::TABLEAU && count == fromPile.getRunLength() && fromPile.getNumFaceDown() > 0;
+		if (m.hasFlippedCard() != revealsCard || (m.getType() == MoveType::TABLEAU_PARTIAL && count == fromPile.getRunLength()))
+			return false;
+		return canPlace(card, count);
+	}
+	case MoveType::STOCK: {
+		if (from.type != PileType::STOCK || !validPile(to) || to.type == PileType::STOCK || !game.stock.hasCards())
+			return false;
+		if (m.getCurrentStockPosition() != game.getStockPosition() || m.getStockMovePosition() >= game.stock.size())
+			return false;
+		if (m.repilesStockFirst() && (!game.isStockDirty() || !game.canRedealStock()))
+			return false;
+		// The card must be one that can be dealt from the current position (or the start, after a repile).
+		const u8 dealFrom = m.repilesStockFirst() ? Game::getStockStartPosition(game.stock.size()) : game.getStockPosition();
+		const bool reachable = (game.getReachableStock(dealFrom) >> m.getStockMovePosition()) & 1;
+		const Card& card = game.stock[m.getStockMovePosition()];
+		return reachable && card == m.getMovedCard() && canPlace(card, 1);
+	}
+	case MoveType::REPILE_STOCK:
+		return m.getCurrentStockPosition() == game.getStockPosition() && game.isStockDirty() && game.canRedealStock();
+	default:
+		return false;
+	}
+}
+
+template <typename Rules>
+bool KlondikeSolver<Rules>::tryDoMove(Game& game, const Move& move) {
+	if (!isMoveLegal(game, move))
+		return false;
+	doMove(game, move);
+	return true;
+}
+
+template class solitaire::KlondikeSolver<DrawOneRules>;
+template class solitaire::KlondikeSolver<DrawThreeRules>;
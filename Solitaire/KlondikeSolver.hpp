@@ -1,17 +1,36 @@
 #pragma once
 
-#include <unordered_set>
-#include <memory>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <optional>
 #include <string>
 
 #include "units.hpp"
+#include "AutoMoveRules.hpp"
 #include "Card.hpp"
 #include "Deck.hpp"
 #include "KlondikeGame.hpp"
 #include "Move.hpp"
+#include "MovePriorities.hpp"
+#include "StateFilter.hpp"
+#include "StateStore.hpp"
+#include "StateTable.hpp"
+#include "TableauMatch.hpp"
 
 namespace solitaire {
 
+	// Bump when a change to the solver could change the results it finds, so results cached by older versions are solved again.
+	constexpr u32 SOLVER_VERSION = 4;
+
+	// Endgames are positions with every tableau card face up. The solver tries to play them straight out to the foundation before searching them.
+	struct EndgameCounts {
+		u64 attempts{ 0 };
+		u64 playOuts{ 0 }; // Attempts that won the game, ending the search.
+		u64 moves{ 0 };    // Moves made by the winning play-outs.
+	};
+
 	struct GameResult {
 		enum class Result {
 			WIN,
@@ -22,60 +41,220 @@ namespace solitaire {
 		u64 seed;
 		MoveList solution;
 		Result result;
+		AutoMoveCounts autoMoves{}; // Moves made by each auto-move rule during the search.
+		EndgameCounts endgame{};
+		u64 sleepingMovesSkipped{ 0 }; // Moves not tried, as the positions they lead to were searched by playing moves in another order.
+		// Searched with an approximate state filter, where a false seen position can cut off a winning line. A LOSE is then probable, not proven.
+		bool approximate{ false };
 	};
 	using GameResults = std::vector<GameResult>;
 
+	// Next move suggested for a game being played (see KlondikeSolver::hint).
+	struct Hint {
+		std::optional<Move> move;  // Move to play next, if any.
+		GameResult::Result result; // WIN if the move is on a winning line, LOSE if the position is lost, or UNKNOWN if the search ran out of time.
+		MoveList line;             // The winning line, or the line the search had got to when it ran out of time.
+		u64 positionsTried;
+	};
+
+	template <typename Rules>
 	class KlondikeSolver {
 	public:
+		using Game = KlondikeGame<Rules>;
+
+
 		const u64 maxStates = 0; // Max states == 0 -> search until solved.
 
-		KlondikeSolver(u64 maxStates = 0) noexcept : maxStates(maxStates) {};
+		KlondikeSolver(u64 maxStates = 0, const MovePriorities& priorities = {}) noexcept : maxStates(maxStates), priorities_(priorities) { _plan_move_stages(); }
 
 		GameResult solve();
+		// Search for up to sliceStates more positions (0 for no limit), then yield. The search is kept in the solver, so it can be resumed
+		// by calling again (EG to interleave several games on one thread). Returns the result once the search ends, or nothing if it yielded.
+		std::optional<GameResult> solveFor(u64 sliceStates);
+		// Whether a search has been started, and has yielded before finishing.
+		bool isSearching() const { return searching_; }
+		u64  getStatesTried() const { return states_tried_; }
 
 		// (Re)set the solver with a new seed.
 		void setSeed(u64 seed);
 		// Set the solver with a game (if in progress, will determine if it is solvable from that point).
-		void setGame(const KlondikeGame& game);
+		void setGame(const Game& game);
+
+		// Interactive hints, for following a game as it is played. Searches for the next move within a time budget, then moves along
+		// with the player's moves. A winning line is kept while the player follows it, and lost positions stay known for the rest of the game.
+		void startHints(const Game& game);
+		// Suggest a move for the current position. If time runs out, the search is kept, and continues from there on the next call.
+		Hint hint(std::chrono::microseconds budget);
+		// Play a move in the hinted game. Returns false, without playing it, if it isn't legal.
+		bool playHintMove(const Move& move);
+
+		AutoMoveRuleSet getAutoMoveRules() const { return auto_move_rules_; }
+		void setAutoMoveRules(AutoMoveRuleSet rules) { auto_move_rules_ = rules; }
+
+		const MovePriorities& getPriorities() const { return priorities_; }
+		void setPriorities(const MovePriorities& priorities) { priorities_ = priorities; _plan_move_stages(); }
+
+		// Keep seen states in an approximate filter of memoryBytes (see StateFilter), instead of exact state tables. Searches far more
+		// positions in the same memory, but losses are only probable. A search also ends, as unknown, once the filter is full.
+		// 0 bytes goes back to exact state tables.
+		void setStateFilter(std::size_t memoryBytes, double falsePositiveRate) { state_filter_ = StateFilter(memoryBytes, falsePositiveRate); }
+		const StateFilter& getStateFilter() const { return state_filter_; }
+		// Keep seen states in a disk-backed store instead (see StateStore), for searches too big for memory. Takes priority over a
+		// state filter. The store is the caller's, and isn't cleared between games. Null goes back to the solver's own seen states.
+		void setStateStore(StateStore* store) { state_store_ = store; }
+
+		// Save a search that has yielded (see solveFor), so it can carry on after a restart. Only for games dealt from a seed, and to be
+		// read back with the same priorities and auto-move rules. Seen states aren't saved: keep them in a StateStore, and checkpoint it
+		// at the same time. Returns false if there is no search to save.
+		bool writeCheckpoint(std::ostream& out) const;
+		// Restore a saved search, replaying its moves on the game dealt from its seed. Returns false, leaving no search, if the checkpoint
+		// is unrecognised, or was written for other rules or another solver version.
+		bool readCheckpoint(std::istream& in);
+		u64  getSeed() const { return game_.getSeed(); }
+
+		// What kind of pages the seen states were given (see AllocatePages).
+		PageKind getStatePageKind() const { return state_filter_.isEnabled() ? state_filter_.getPageKind() : seen_states_.getPageKind(); }
 
 	public:
-		static void doMove(KlondikeGame& game, const Move& move);
+		static void doMove(Game& game, const Move& move);
+		// Full rules check of a move against the game, including the details packed into the move (EG stock positions, revealed cards).
+		static bool isMoveLegal(const Game& game, const Move& move);
+		// Checked doMove, for replaying untrusted moves. Returns false without changing the game if the move is illegal.
+		static bool tryDoMove(Game& game, const Move& move);
 
 	private:
 		struct PriorityMove {
 			Move move;
-			u32 priority;
+			std::int32_t priority;
 		};
 		using PriorityMoveList = std::vector<PriorityMove>;
 
+		// Kinds of move, each with its own range of priorities.
+		enum class MoveKind : u8 {
+			REVEAL, // Moves off the tableau that flip a card.
+			CLEAR_WITH_KING,
+			STOCK,
+			TABLEAU_TO_FOUNDATION,
+			STOCK_AFTER_REPILE,
+			PARTIAL,
+			FOUNDATION_TO_TABLEAU,
+			TOTAL_KINDS,
+		};
+		using MoveKindSet = u8;
+		static constexpr MoveKindSet _kind_bit(MoveKind kind) { return static_cast<MoveKindSet>(1u << toUType(kind)); }
+
 		void _init();
 		bool _is_king_available() const;
 		bool _is_card_available(const Card& cardToFind) const;
-		// Returns true if the game has been won.
-		GameResult::Result _solve_recursive(u32 depth);
+		// A position on the search path: the auto-moves made on reaching it, and the moves to try from it.
+		struct SearchFrame {
+			MoveList autoMoves;
+			PriorityMoveList moves;
+			std::size_t next = 0; // Next move to try.
+			u8 stage = 0;         // Next stage of moves to find, once these are used up.
+			StateTable::Key key;
+			MoveList sleep; // Moves not to try from here (see _inherit_sleep_set).
+			bool unproven = false; // Whether the search below cut a cycle, so failing doesn't prove the position lost.
+		};
+		enum class StateCheck {
+			NEW,
+			SEEN,
+			LOST, // Proven lost by an earlier hint search.
+		};
+
+		// Enter the position reached by the last move. Returns LOSE if it has been seen before, WIN or UNKNOWN if the search ends there,
+		// or nothing if it was pushed on the search stack to search from.
+		std::optional<GameResult::Result> _enter_position();
+		// Sleep sets: skip orderings of independent moves that have already been searched in another order.
+		void _inherit_sleep_set(const SearchFrame& parent, SearchFrame& child) const;
 
 		void _do_move(const Move& m);
 		void _undo_move(const Move& m);
 
-		void _find_full_run_moves(PriorityMoveList& availableMoves);
-		void _find_moves_to_foundation(PriorityMoveList& availableMoves);
-		void _find_stock_to_tableau_moves(PriorityMoveList& availableMoves);
-		void _find_partial_run_moves(PriorityMoveList& availableMoves);
+		void _rebuild_card_masks();
+		// Toggle a pile's contribution to the card masks. Called on a move's piles before and after it is applied.
+		void _toggle_pile_masks(const PileID& id);
+		void _update_stock_mask();
+
+		using StockPositions = KlondikeBoard::StockPositions;
+		// Stock positions that can be dealt to, split by whether the stock has to be repiled first.
+		struct StockReach {
+			StockPositions direct;
+			StockPositions afterRepile;
+		};
+		StockReach _stock_reach() const;
+		// Reachable positions for the stock kinds of move in a set.
+		static StockPositions _stock_positions(const StockReach& reach, MoveKindSet kinds);
+		// Every reachable stock card is a single move, repiling first if need be.
+		PriorityMove _stock_move(const Card& card, u8 stockPosition, PileID toPile, const StockReach& reach) const;
+		// Split stock moves that repile first into the two moves a player makes, given the moves lead up to the current game.
+		MoveList _expand_stock_moves(const MoveList& moves) const;
+
+		void _find_full_run_moves(PriorityMoveList& availableMoves, MoveKindSet kinds);
+		void _find_moves_to_foundation(PriorityMoveList& availableMoves, MoveKindSet kinds);
+		void _find_stock_to_tableau_moves(PriorityMoveList& availableMoves, MoveKindSet kinds);
+		void _find_partial_run_moves(PriorityMoveList& availableMoves, MoveKindSet kinds);
+		void _find_foundation_to_tableau_moves(PriorityMoveList& availableMoves, MoveKindSet kinds);
 
-		std::unique_ptr<Move> _find_auto_move();
-		// Returns true if any available moves were found.
-		PriorityMoveList _find_available_moves();
+		bool _is_rule_enabled(AutoMoveRule rule) const { return (auto_move_rules_ & AutoMoveRuleBit(rule)) != 0; }
+		// Cards that can be moved to the foundation without impacting chances of game success (whether or not they can currently be moved there).
+		CardMask _safe_foundation_cards() const;
+		// Count a move made by an auto-move rule.
+		std::optional<Move> _use_auto_move(AutoMoveRule rule, const Move& move);
+		std::optional<Move> _find_stock_auto_move(u8 testStockPosition, CardMask safeCards);
+		std::optional<Move> _find_auto_move();
+		// Whether every tableau card is face up.
+		bool _is_endgame() const;
+		// Try to win an endgame by only moving cards to the foundation (repiling the stock when stuck).
+		// Always succeeds once the stock is empty, as the lowest card left is then always on top of its pile. Undoes its moves on failure.
+		bool _play_out_endgame();
+		// Group the kinds of move into stages, in priority order, for the current priorities.
+		void _plan_move_stages();
+		// Add the next stage of moves from the current position to the frame's moves, in the order to try them.
+		// Returns false if there are no stages left.
+		bool _find_next_stage_moves(SearchFrame& frame);
 
-		bool _is_seen_state();
+		void _get_state_key(StateTable::Key& out_key) const;
+		// Look up the current state, adding it to the seen states if it's new.
+		StateCheck _check_state(StateTable::Key& out_key);
 
-		KlondikeGame game_;
+		MovePriorities priorities_;
+		std::array<MoveKindSet, toUType(MoveKind::TOTAL_KINDS)> move_stages_{}; // Kinds of move found in each stage.
+		u8 num_move_stages_ = 0;
+		AutoMoveRuleSet auto_move_rules_ = DEFAULT_AUTO_MOVE_RULES;
+		AutoMoveCounts auto_move_counts_{};
+		EndgameCounts endgame_counts_{};
+		u64 sleeping_moves_skipped_ = 0;
+		Game game_;
 		MoveList move_sequence_;
 
-		Deck partial_run_move_cards_; // Keeps track of partial run moves, to stop cards from being moved back and forth.
+		// Card sets kept up to date with every move, so that availability checks during move generation are a single mask test.
+		CardMask tableau_tops_ = 0;        // Topmost card of each tableau pile.
+		CardMask run_tops_ = 0;            // First face-up card of each tableau pile.
+		CardMask stock_available_ = 0;     // Stock cards reachable from the current stock position.
+		CardMask foundation_playable_ = 0; // Next card for each foundation pile.
+		CardMask partial_run_moved_ = 0;   // Keeps track of partial run moves, to stop cards from being moved back and forth.
+		TableauTargets tableau_targets_ = 0; // Card each tableau pile accepts (see TableauMatch.hpp).
 
 		u64 states_tried_ = 0;
-		std::unordered_set<std::string> seen_states_;
+		StateTable seen_states_;
+		StateFilter state_filter_; // Used instead of seen_states_, if enabled.
+		StateStore* state_store_ = nullptr; // Used instead of either, if set.
+		std::vector<SearchFrame> search_stack_; // Frames past the search depth are kept for reuse.
+		u32 search_depth_ = 0;
+		bool searching_ = false;
+
+		static constexpr u64 HINT_SLICE_STATES = 256; // Positions searched between checks of a hint's time budget.
+		bool hinting_ = false;
+		Game hint_root_;
+		MoveList hint_line_;      // Winning line from the hint root, if one has been found.
+		StateTable lost_states_;  // Positions proven lost while hinting the current game.
 
-		static constexpr u8 UNIQUE_STATE_SIZE = 48;
+		// A limited number of redeals needs to be part of the state, as it changes which moves are available.
+		static constexpr u8 UNIQUE_STATE_SIZE = Rules::REDEAL_LIMIT == UNLIMITED_REDEALS ? 48 : 49;
+		static_assert(UNIQUE_STATE_SIZE < StateTable::KEY_SIZE, "State packing writes two bytes at a time, so needs a byte of padding.");
 	};
+
+	extern template class KlondikeSolver<DrawOneRules>;
+	extern template class KlondikeSolver<DrawThreeRules>;
 }
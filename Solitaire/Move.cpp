@@ -3,14 +3,14 @@
 using namespace solitaire;
 
 Move Move::TableauPartial(const Card& movedCard, PileID fromPile, PileID toPile, u8 cardsToMove) {
-	return Move(movedCard, fromPile, toPile, cardsToMove, MoveType::TABLEAU_PARTIAL, false);
+	return Move(GetCardIndex(movedCard), fromPile, toPile, cardsToMove, 0, MoveType::TABLEAU_PARTIAL, false);
 }
 Move Move::Tableau(const Card& movedCard, PileID fromPile, PileID toPile, u8 cardsToMove, bool flippedCard) {
-	return Move(movedCard, fromPile, toPile, cardsToMove, MoveType::TABLEAU, flippedCard);
+	return Move(GetCardIndex(movedCard), fromPile, toPile, cardsToMove, 0, MoveType::TABLEAU, flippedCard);
 }
-Move Move::Stock(const Card& movedCard, u8 currentStockPosition, u8 stockMovePosition, PileID toPile) {
-	return Move(movedCard, PileID{ PileType::STOCK }, toPile, currentStockPosition, stockMovePosition, MoveType::STOCK);
+Move Move::Stock(const Card& movedCard, u8 currentStockPosition, u8 stockMovePosition, PileID toPile, bool repileFirst) {
+	return Move(GetCardIndex(movedCard), PileID{ PileType::STOCK }, toPile, currentStockPosition, stockMovePosition, MoveType::STOCK, repileFirst);
 }
 Move Move::RepileStock(u8 stockPosition) {
-	return Move(Card{}, PileID{}, PileID{}, stockPosition, 0, MoveType::REPILE_STOCK);
+	return Move(0, PileID{}, PileID{}, stockPosition, 0, MoveType::REPILE_STOCK, false);
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -8,7 +9,7 @@
 #include "KlondikeGame.hpp"
 
 namespace solitaire {
-	enum class MoveType {
+	enum class MoveType : u8 {
 		TABLEAU,
 		TABLEAU_PARTIAL,
 		STOCK,
@@ -25,37 +26,74 @@ namespace solitaire {
 		return "?";
 	}
 
-	class Move { // Holds information for a move, as well as what's needed to undo that move.
+	// Holds information for a move, as well as what's needed to undo that move.
+	// Packed into a single 32 bit word, to keep move stacks and stored solutions small.
+	class Move {
 	public:
-		Card movedCard;
-		PileID fromPile;
-		PileID toPile;
-		union {
-			u8 cardsToMove;
-			u8 currentStockPosition; // If type is STOCK or REPILE_STOCK, indicates pre-move position.
-		};
-		u8 stockMovePosition = 0; // If type is STOCK, indicates position in stock to move from.
-		MoveType type;
-		bool flippedCard = false; // Whether the move caused a card to be flipped.
+		Move() = default;
+
+		inline Card     getMovedCard() const { return CardFromIndex(_get(CARD_SHIFT, CARD_BITS)); }
+		inline PileID   getFromPile() const { return PileID{ static_cast<PileType>(_get(FROM_TYPE_SHIFT, PILE_TYPE_BITS)), _get(FROM_INDEX_SHIFT, PILE_INDEX_BITS) }; }
+		inline PileID   getToPile() const { return PileID{ static_cast<PileType>(_get(TO_TYPE_SHIFT, PILE_TYPE_BITS)), _get(TO_INDEX_SHIFT, PILE_INDEX_BITS) }; }
+		inline u8       getCardsToMove() const { return _get(COUNT_SHIFT, POSITION_BITS); }
+		inline u8       getCurrentStockPosition() const { return _get(COUNT_SHIFT, POSITION_BITS); } // If type is STOCK or REPILE_STOCK, indicates pre-move position.
+		inline u8       getStockMovePosition() const { return _get(STOCK_MOVE_SHIFT, POSITION_BITS); } // If type is STOCK, indicates position in stock to move from.
+		inline MoveType getType() const { return static_cast<MoveType>(_get(TYPE_SHIFT, TYPE_BITS)); }
+		inline bool     hasFlippedCard() const { return _get(FLIPPED_SHIFT, 1) != 0; } // Whether the move caused a card to be flipped.
+		inline bool     repilesStockFirst() const { return _get(FLIPPED_SHIFT, 1) != 0; } // If type is STOCK, whether the stock is repiled before dealing to the card.
+
+		inline std::uint32_t getCode() const { return code_; }
+		static Move FromCode(std::uint32_t code) { return Move(code); }
+
+		inline bool operator==(const Move& o) const { return code_ == o.code_; }
+		inline bool operator!=(const Move& o) const { return code_ != o.code_; }
 
 		static Move TableauPartial(const Card& movedCard, PileID fromPile, PileID toPile, u8 cardsToMove); // Move a partial run.
 		static Move Tableau(const Card& movedCard, PileID fromPile, PileID toPile, u8 cardsToMove, bool flippedCard);  // Move one or more cards from a tableau pile to another pile.
-		static Move Stock(const Card& movedCard, u8 currentStockPosition, u8 stockMovePosition, PileID toPile); // Move a card from the stock pile to another pile.
+		// Move a card from the stock pile to another pile. Can repile the stock first, to reach cards behind the current position.
+		static Move Stock(const Card& movedCard, u8 currentStockPosition, u8 stockMovePosition, PileID toPile, bool repileFirst = false);
 		static Move RepileStock(u8 stockPosition); // Repile/reset the stock.
 
 	private:
-		constexpr explicit Move(const Card& movedCard, PileID fromPile, PileID toPile, u8 cardsToMove, MoveType type, bool flippedCard) noexcept
-			: movedCard(movedCard), fromPile(fromPile), toPile(toPile), cardsToMove(cardsToMove), type(type), flippedCard(flippedCard) {}
-		constexpr explicit Move(const Card& movedCard, PileID fromPile, PileID toPile, u8 stockPosition, u8 stockMovePosition, MoveType type) noexcept
-			: movedCard(movedCard), fromPile(fromPile), toPile(toPile), currentStockPosition(stockPosition), stockMovePosition(stockMovePosition), type(type) {}
+		static constexpr u8 CARD_BITS = 6;
+		static constexpr u8 PILE_TYPE_BITS = 2;
+		static constexpr u8 PILE_INDEX_BITS = 3;
+		static constexpr u8 POSITION_BITS = 5; // Card counts and stock positions.
+		static constexpr u8 TYPE_BITS = 2;
+
+		static constexpr u8 CARD_SHIFT = 0;
+		static constexpr u8 FROM_TYPE_SHIFT = CARD_SHIFT + CARD_BITS;
+		static constexpr u8 FROM_INDEX_SHIFT = FROM_TYPE_SHIFT + PILE_TYPE_BITS;
+		static constexpr u8 TO_TYPE_SHIFT = FROM_INDEX_SHIFT + PILE_INDEX_BITS;
+		static constexpr u8 TO_INDEX_SHIFT = TO_TYPE_SHIFT + PILE_TYPE_BITS;
+		static constexpr u8 COUNT_SHIFT = TO_INDEX_SHIFT + PILE_INDEX_BITS;
+		static constexpr u8 STOCK_MOVE_SHIFT = COUNT_SHIFT + POSITION_BITS;
+		static constexpr u8 TYPE_SHIFT = STOCK_MOVE_SHIFT + POSITION_BITS;
+		static constexpr u8 FLIPPED_SHIFT = TYPE_SHIFT + TYPE_BITS;
+		static_assert(FLIPPED_SHIFT < 32, "Move does not fit in 32 bits.");
+		static_assert(CARDS_PER_DECK < (1 << CARD_BITS) && toUType(PileType::TOTAL_TYPES) <= (1 << PILE_TYPE_BITS));
+		static_assert(CARDS_PER_DECK - 28 <= (1 << POSITION_BITS), "Stock positions must fit in a move."); // 28 cards are dealt to the tableau.
+
+		constexpr explicit Move(std::uint32_t code) noexcept : code_(code) {}
+		constexpr explicit Move(u8 cardIndex, PileID fromPile, PileID toPile, u8 countOrPosition, u8 stockMovePosition, MoveType type, bool flippedCard) noexcept
+			: code_(static_cast<std::uint32_t>(cardIndex) << CARD_SHIFT
+				| static_cast<std::uint32_t>(toUType(fromPile.type)) << FROM_TYPE_SHIFT | static_cast<std::uint32_t>(fromPile.index) << FROM_INDEX_SHIFT
+				| static_cast<std::uint32_t>(toUType(toPile.type)) << TO_TYPE_SHIFT | static_cast<std::uint32_t>(toPile.index) << TO_INDEX_SHIFT
+				| static_cast<std::uint32_t>(countOrPosition) << COUNT_SHIFT | static_cast<std::uint32_t>(stockMovePosition) << STOCK_MOVE_SHIFT
+				| static_cast<std::uint32_t>(toUType(type)) << TYPE_SHIFT | static_cast<std::uint32_t>(flippedCard) << FLIPPED_SHIFT) {}
+
+		inline u8 _get(u8 shift, u8 bits) const { return static_cast<u8>((code_ >> shift) & ((1u << bits) - 1)); }
+
+		std::uint32_t code_ = 0;
 	};
+	static_assert(sizeof(Move) == sizeof(std::uint32_t));
 
 	using MoveList = std::vector<Move>;
 
 	inline std::string MoveToStr(const Move& m) {
-		std::string moveStr = MoveTypeToStr(m.type);
-		if (m.type != MoveType::REPILE_STOCK) {
-			moveStr += " " + CardToStr(m.movedCard);
+		std::string moveStr = MoveTypeToStr(m.getType());
+		if (m.getType() != MoveType::REPILE_STOCK) {
+			moveStr += " " + CardToStr(m.getMovedCard());
 		}
 		return moveStr;
 	}
@@ -0,0 +1,68 @@
+#include "MovePriorities.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace solitaire;
+
+const MovePriorityField solitaire::MOVE_PRIORITY_FIELDS[9] = {
+	{ "reveal",                &MovePriorities::reveal },
+	{ "clear-with-king",       &MovePriorities::clearWithKing },
+	{ "stock",                 &MovePriorities::stock },
+	{ "tableau-to-foundation", &MovePriorities::tableauToFoundation },
+	{ "repile-stock",          &MovePriorities::repileStock },
+	{ "partial",               &MovePriorities::partial },
+	{ "foundation-to-tableau", &MovePriorities::foundationToTableau },
+	{ "reveal-depth-weight",   &MovePriorities::revealDepthWeight },
+	{ "stock-position-weight", &MovePriorities::stockPositionWeight },
+};
+
+bool MovePriorities::operator==(const MovePriorities& o) const {
+	for (const auto& field : MOVE_PRIORITY_FIELDS) {
+		if (this->*field.weight != o.*field.weight)
+			return false;
+	}
+	return true;
+}
+
+bool solitaire::LoadMovePriorities(const std::string& path, MovePriorities& out_priorities) {
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		std::cerr << "LoadMovePriorities: Failed to open priorities file: " << path << "\n";
+		return false;
+	}
+	MovePriorities priorities(out_priorities);
+	std::string line;
+	while (std::getline(file, line)) {
+		std::istringstream lineStream(line);
+		std::string name;
+		if (!(lineStream >> name) || name[0] == '#')
+			continue;
+		bool found = false;
+		for (const auto& field : MOVE_PRIORITY_FIELDS) {
+			if (name == field.name) {
+				found = static_cast<bool>(lineStream >> (priorities.*field.weight));
+				break;
+			}
+		}
+		if (!found) {
+			std::cerr << "LoadMovePriorities: Invalid priority entry: " << line << "\n";
+			return false;
+		}
+	}
+	out_priorities = priorities;
+	return true;
+}
+
+bool solitaire::WriteMovePriorities(const std::string& path, const MovePriorities& priorities) {
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open()) {
+		std::cerr << "WriteMovePriorities: Failed to open priorities file: " << path << "\n";
+		return false;
+	}
+	file << "# Solitaire solver move priorities. Lower priority moves are tried first.\n";
+	for (const auto& field : MOVE_PRIORITY_FIELDS)
+		file << field.name << " " << priorities.*field.weight << "\n";
+	return static_cast<bool>(file);
+}
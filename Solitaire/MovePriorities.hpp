@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace solitaire {
+	// -------------------------------- Move Strategy -----------------------------------------------
+	// Weights used by the solver to order moves. Lower priority moves are tried first.
+	// Base priorities are padded such that if they are EG 100, then they can be subtracted from to make them higher priority.
+	struct MovePriorities {
+		std::int32_t reveal = 100;              // Moves that reveal a card. Adjusted by how many cards are flipped in the stack (Klondike has max 6).
+		std::int32_t clearWithKing = 200;       // Clearning an empty board spot when there is a king available to occupy it.
+		std::int32_t stock = 300;               // Moves from stock pile (to tableau or foundation). Higher priority towards the end of the stock pile.
+		std::int32_t tableauToFoundation = 400;
+		std::int32_t repileStock = 400;
+		std::int32_t partial = 600;             // Intra-tableau moves that don't reveal a card or clear a space.
+		std::int32_t foundationToTableau = 700; // Moving a card back off of the foundation (only for rulesets that allow it).
+		std::int32_t revealDepthWeight = 1;     // Subtracted from reveal priority for each face-down card in the pile.
+		std::int32_t stockPositionWeight = 1;   // Subtracted from stock priority for each position into the stock.
+
+		bool operator==(const MovePriorities& o) const;
+		bool operator!=(const MovePriorities& o) const { return !(*this == o); }
+	};
+	// ----------------------------------------------------------------------------------------------
+
+	struct MovePriorityField {
+		const char* name;
+		std::int32_t MovePriorities::* weight;
+	};
+	// All weights, by the names used in priority config files.
+	extern const MovePriorityField MOVE_PRIORITY_FIELDS[9];
+
+	// Priority config files have one "name value" pair per line. Lines starting with '#' are ignored, as are missing weights.
+	// Returns false if the file can't be read or contains an unknown weight.
+	bool LoadMovePriorities(const std::string& path, MovePriorities& out_priorities);
+	bool WriteMovePriorities(const std::string& path, const MovePriorities& priorities);
+}
@@ -0,0 +1,187 @@
+#include "Platform.hpp"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace solitaire;
+
+namespace {
+	constexpr std::size_t LARGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+	constexpr std::size_t _round_up(std::size_t size, std::size_t multiple) {
+		return (size + multiple - 1) / multiple * multiple;
+	}
+}
+
+const char* solitaire::PageKindToStr(PageKind kind) {
+	switch (kind) {
+	case PageKind::NONE:        return "none";
+	case PageKind::STANDARD:    return "standard pages";
+	case PageKind::TRANSPARENT: return "transparent huge pages";
+	case PageKind::LARGE:       return "large pages";
+	default:                    return "unknown";
+	}
+}
+
+#ifdef _WIN32
+PageAllocation solitaire::AllocatePages(std::size_t size) {
+	PageAllocation allocation;
+	// Large pages need the "lock pages in memory" privilege, so expect this to fail for most users.
+	if (const std::size_t largeMin = ::GetLargePageMinimum(); largeMin > 0) {
+		const std::size_t largeSize = _round_up(size, largeMin);
+		if (void* data = ::VirtualAlloc(nullptr, largeSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE)) {
+			allocation = { data, largeSize, PageKind::LARGE };
+			return allocation;
+		}
+	}
+	if (void* data = ::VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE))
+		allocation = { data, size, PageKind::STANDARD };
+	return allocation;
+}
+
+void solitaire::FreePages(PageAllocation& allocation) {
+	if (allocation.data)
+		::VirtualFree(allocation.data, 0, MEM_RELEASE);
+	allocation = {};
+}
+
+bool solitaire::MapFile(const std::string& path, MappedFile& out_file) {
+	out_file = {};
+	HANDLE file = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if (!::GetFileSizeEx(file, &size)) {
+		::CloseHandle(file);
+		return false;
+	}
+	out_file.fileHandle = file;
+	if (size.QuadPart == 0)
+		return true;
+	HANDLE mapping = ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	const void* data = mapping ? ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (!data) {
+		if (mapping)
+			::CloseHandle(mapping);
+		::CloseHandle(file);
+		out_file = {};
+		return false;
+	}
+	out_file.data = data;
+	out_file.size = static_cast<std::size_t>(size.QuadPart);
+	out_file.mappingHandle = mapping;
+	return true;
+}
+
+void solitaire::UnmapFile(MappedFile& file) {
+	if (file.data)
+		::UnmapViewOfFile(file.data);
+	if (file.mappingHandle)
+		::CloseHandle(file.mappingHandle);
+	if (file.fileHandle)
+		::CloseHandle(file.fileHandle);
+	file = {};
+}
+
+bool solitaire::PinThreadToCore(u32 coreIndex) {
+	DWORD_PTR processMask, systemMask;
+	if (!::GetProcessAffinityMask(::GetCurrentProcess(), &processMask, &systemMask) || processMask == 0)
+		return false;
+	u32 numCores = 0;
+	for (DWORD_PTR m = processMask; m != 0; m &= m - 1)
+		++numCores;
+	coreIndex %= numCores;
+	for (u32 bit = 0; bit < sizeof(DWORD_PTR) * 8; ++bit) {
+		if ((processMask & (DWORD_PTR{ 1 } << bit)) && coreIndex-- == 0)
+			return ::SetThreadAffinityMask(::GetCurrentThread(), DWORD_PTR{ 1 } << bit) != 0;
+	}
+	return false;
+}
+#else
+PageAllocation solitaire::AllocatePages(std::size_t size) {
+	PageAllocation allocation;
+	const std::size_t largeSize = _round_up(size, LARGE_PAGE_SIZE);
+#ifdef MAP_HUGETLB
+	// Explicit huge pages only work if the system has reserved some (vm.nr_hugepages).
+	if (void* data = ::mmap(nullptr, largeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0); data != MAP_FAILED) {
+		allocation = { data, largeSize, PageKind::LARGE };
+		return allocation;
+	}
+#endif
+	void* data = ::mmap(nullptr, largeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (data == MAP_FAILED)
+		return allocation;
+	allocation = { data, largeSize, PageKind::STANDARD };
+#ifdef MADV_HUGEPAGE
+	if (::madvise(data, largeSize, MADV_HUGEPAGE) == 0)
+		allocation.kind = PageKind::TRANSPARENT;
+#endif
+	return allocation;
+}
+
+void solitaire::FreePages(PageAllocation& allocation) {
+	if (allocation.data)
+		::munmap(allocation.data, allocation.size);
+	allocation = {};
+}
+
+bool solitaire::MapFile(const std::string& path, MappedFile& out_file) {
+	out_file = {};
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat info;
+	bool ok = ::fstat(fd, &info) == 0;
+	if (ok && info.st_size > 0) {
+		void* data = ::mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+		ok = data != MAP_FAILED;
+		if (ok)
+			out_file = { data, static_cast<std::size_t>(info.st_size) };
+	}
+	::close(fd); // The mapping keeps its own reference to the file.
+	return ok;
+}
+
+void solitaire::UnmapFile(MappedFile& file) {
+	if (file.data)
+		::munmap(const_cast<void*>(file.data), file.size);
+	file = {};
+}
+
+bool solitaire::PinThreadToCore(u32 coreIndex) {
+#ifdef __linux__
+	// Read once, before any thread has been pinned, so that every call maps the same index to the same core.
+	static const cpu_set_t allowed = [] {
+		cpu_set_t cpus;
+		if (::sched_getaffinity(0, sizeof(cpus), &cpus) != 0)
+			CPU_ZERO(&cpus);
+		return cpus;
+	}();
+	const int numCores = CPU_COUNT(&allowed);
+	if (numCores == 0)
+		return false;
+	coreIndex %= static_cast<u32>(numCores);
+	for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+		if (CPU_ISSET(cpu, &allowed) && coreIndex-- == 0) {
+			cpu_set_t pinned;
+			CPU_ZERO(&pinned);
+			CPU_SET(cpu, &pinned);
+			return ::pthread_setaffinity_np(::pthread_self(), sizeof(pinned), &pinned) == 0;
+		}
+	}
+	return false;
+#else
+	(void)coreIndex;
+	return false;
+#endif
+}
+#endif
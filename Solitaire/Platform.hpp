@@ -0,0 +1,46 @@
+#pragma once
+
+#include "units.hpp"
+
+#include <cstddef>
+#include <string>
+
+// Platform specific helpers for placing solvers on the machine (pinning threads to cores, and large page memory), and memory mapped files.
+
+namespace solitaire {
+	enum class PageKind : u8 {
+		NONE,        // Nothing allocated.
+		STANDARD,    // Regular pages.
+		TRANSPARENT, // Regular mapping, with the OS asked to back it with huge pages (EG madvise).
+		LARGE,       // Explicit large/huge pages.
+	};
+	const char* PageKindToStr(PageKind kind);
+
+	struct PageAllocation {
+		void* data{ nullptr };
+		std::size_t size{ 0 };
+		PageKind kind{ PageKind::NONE };
+	};
+
+	// Allocates zeroed memory, trying explicit large pages first, then transparent huge pages, then falling back to regular pages.
+	// Memory is placed on the NUMA node of the first thread to touch it, so allocate from the thread that will use it.
+	// Returns an allocation with no data on failure.
+	PageAllocation AllocatePages(std::size_t size);
+	void FreePages(PageAllocation& allocation);
+
+	struct MappedFile {
+		const void* data{ nullptr };
+		std::size_t size{ 0 };
+#ifdef _WIN32
+		void* fileHandle{ nullptr };
+		void* mappingHandle{ nullptr };
+#endif
+	};
+
+	// Map a whole file read-only. Returns false if it can't be opened or mapped (an empty file maps to no data, and succeeds).
+	bool MapFile(const std::string& path, MappedFile& out_file);
+	void UnmapFile(MappedFile& file);
+
+	// Pin the calling thread to the nth core it is allowed to run on (wrapping around). Returns false if it isn't supported or fails.
+	bool PinThreadToCore(u32 coreIndex);
+}
@@ -0,0 +1,200 @@
+#include "ResultCache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+using namespace solitaire;
+
+namespace {
+	constexpr const char* INDEX_FILE = "index.bin";
+	constexpr const char* JOURNAL_FILE = "journal.bin";
+	constexpr const char* TEMP_INDEX_FILE = "index.tmp";
+
+	struct FileHeader {
+		char magic[8]{ 'S', 'O', 'L', 'C', 'A', 'C', 'H', 'E' };
+		std::uint32_t version{ 1 };
+		std::uint32_t recordSize{ sizeof(CachedResult) };
+	};
+	static_assert(sizeof(FileHeader) == 16);
+
+	bool _is_valid_header(const FileHeader& header) {
+		const FileHeader expected;
+		return std::memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0 && header.version == expected.version && header.recordSize == expected.recordSize;
+	}
+
+	bool _key_less(const CachedResult& lhs, const CachedResult& rhs) {
+		return lhs.seed < rhs.seed || (lhs.seed == rhs.seed && lhs.configKey < rhs.configKey);
+	}
+
+	bool _write_header(std::ofstream& file) {
+		const FileHeader header;
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		return static_cast<bool>(file);
+	}
+}
+
+bool solitaire::IsReusable(const CachedResult& result, u64 maxStates) {
+	if (result.outcome != SeedOutcome::UNKNOWN)
+		return true;
+	if (maxStates == 0)
+		return result.maxStates == 0;
+	return result.maxStates == 0 || maxStates <= result.maxStates;
+}
+
+ResultCache::~ResultCache() {
+	UnmapFile(index_);
+}
+
+bool ResultCache::open(const std::string& directory) {
+	UnmapFile(index_);
+	index_count_ = 0;
+	journal_.clear();
+	unflushed_.clear();
+	directory_ = directory;
+	if (!directory_.empty() && directory_.back() != '/' && directory_.back() != '\\')
+		directory_ += '/';
+
+	std::error_code error;
+	std::filesystem::create_directories(directory_, error);
+	if (error) {
+		std::cerr << "ResultCache::open: Failed to create cache directory: " << directory_ << "\n";
+		return false;
+	}
+	if (!_map_index())
+		return false;
+
+	// Load the journal. A run that stopped mid-write can leave a partial record at the end, which is dropped.
+	const std::string journalPath = directory_ + JOURNAL_FILE;
+	std::ifstream journal(journalPath, std::ios::binary);
+	if (!journal.is_open())
+		return true;
+	FileHeader header;
+	if (!journal.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+		journal.close();
+		std::filesystem::remove(journalPath, error);
+		return true;
+	}
+	if (!_is_valid_header(header)) {
+		std::cerr << "ResultCache::open: Unrecognised journal: " << journalPath << "\n";
+		return false;
+	}
+	u64 records = 0;
+	for (CachedResult result; journal.read(reinterpret_cast<char*>(&result), sizeof(result)); ++records)
+		journal_[{ result.seed, result.configKey }] = result;
+	journal.close();
+	const u64 validSize = sizeof(FileHeader) + records * sizeof(CachedResult);
+	if (std::filesystem::file_size(journalPath, error) != validSize && !error)
+		std::filesystem::resize_file(journalPath, validSize, error);
+	return true;
+}
+
+std::optional<CachedResult> ResultCache::find(u64 seed, u32 configKey) const {
+	if (auto it = journal_.find({ seed, configKey }); it != journal_.end())
+		return it->second;
+	const CachedResult* begin = _index_begin();
+	const CachedResult* end = begin + index_count_;
+	CachedResult key;
+	key.seed = seed;
+	key.configKey = configKey;
+	const CachedResult* it = std::lower_bound(begin, end, key, _key_less);
+	if (it != end && it->seed == seed && it->configKey == configKey)
+		return *it;
+	return std::nullopt;
+}
+
+void ResultCache::add(const CachedResult& result) {
+	journal_[{ result.seed, result.configKey }] = result;
+	unflushed_.push_back(result);
+}
+
+bool ResultCache::flush() {
+	if (unflushed_.empty())
+		return true;
+	const std::string journalPath = directory_ + JOURNAL_FILE;
+	std::error_code error;
+	const bool isNew = !std::filesystem::exists(journalPath, error);
+	std::ofstream journal(journalPath, std::ios::binary | std::ios::app);
+	if (!journal.is_open() || (isNew && !_write_header(journal))) {
+		std::cerr << "ResultCache::flush: Failed to open journal: " << journalPath << "\n";
+		return false;
+	}
+	journal.write(reinterpret_cast<const char*>(unflushed_.data()), static_cast<std::streamsize>(unflushed_.size() * sizeof(CachedResult)));
+	if (!journal.flush()) {
+		std::cerr << "ResultCache::flush: Failed to write journal: " << journalPath << "\n";
+		return false;
+	}
+	unflushed_.clear();
+	return true;
+}
+
+bool ResultCache::compact() {
+	if (!flush())
+		return false;
+	if (journal_.empty())
+		return true;
+
+	// Both are sorted by key, so merge them, with journal results replacing the index's.
+	const std::string tempPath = directory_ + TEMP_INDEX_FILE;
+	std::ofstream temp(tempPath, std::ios::binary | std::ios::trunc);
+	if (!temp.is_open() || !_write_header(temp)) {
+		std::cerr << "ResultCache::compact: Failed to write new index: " << tempPath << "\n";
+		return false;
+	}
+	const CachedResult* indexIt = _index_begin();
+	const CachedResult* indexEnd = indexIt + index_count_;
+	for (const auto& [key, result] : journal_) {
+		for (; indexIt != indexEnd && _key_less(*indexIt, result); ++indexIt)
+			temp.write(reinterpret_cast<const char*>(indexIt), sizeof(CachedResult));
+		if (indexIt != indexEnd && !_key_less(result, *indexIt))
+			++indexIt;
+		temp.write(reinterpret_cast<const char*>(&result), sizeof(CachedResult));
+	}
+	temp.write(reinterpret_cast<const char*>(indexIt), static_cast<std::streamsize>((indexEnd - indexIt) * sizeof(CachedResult)));
+	temp.close();
+	if (!temp) {
+		std::cerr << "ResultCache::compact: Failed to write new index: " << tempPath << "\n";
+		return false;
+	}
+
+	// Replace the index before removing the journal. If we stop in between, the journal is just applied again.
+	UnmapFile(index_);
+	index_count_ = 0;
+	std::error_code error;
+	std::filesystem::rename(tempPath, directory_ + INDEX_FILE, error);
+	if (error) {
+		std::cerr << "ResultCache::compact: Failed to replace index: " << error.message() << "\n";
+		_map_index();
+		return false;
+	}
+	std::filesystem::remove(directory_ + JOURNAL_FILE, error);
+	journal_.clear();
+	return _map_index();
+}
+
+bool ResultCache::_map_index() {
+	const std::string indexPath = directory_ + INDEX_FILE;
+	std::error_code error;
+	if (!std::filesystem::exists(indexPath, error))
+		return true;
+	if (!MapFile(indexPath, index_)) {
+		std::cerr << "ResultCache: Failed to map index: " << indexPath << "\n";
+		return false;
+	}
+	if (index_.size < sizeof(FileHeader) || !_is_valid_header(*static_cast<const FileHeader*>(index_.data))
+		|| (index_.size - sizeof(FileHeader)) % sizeof(CachedResult) != 0) {
+		std::cerr << "ResultCache: Unrecognised index: " << indexPath << "\n";
+		UnmapFile(index_);
+		return false;
+	}
+	index_count_ = (index_.size - sizeof(FileHeader)) / sizeof(CachedResult);
+	return true;
+}
+
+const CachedResult* ResultCache::_index_begin() const {
+	if (!index_.data)
+		return nullptr;
+	return reinterpret_cast<const CachedResult*>(static_cast<const char*>(index_.data) + sizeof(FileHeader));
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "units.hpp"
+#include "Platform.hpp"
+#include "ResultsMerge.hpp"
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Persistent cache of seed results, shared by runs that use the same cache directory.
+// Results are kept in a sorted index file, which is memory mapped and binary searched, and new results are appended to a journal.
+// Compacting merges the journal into a new index. Only one run should use a cache directory at a time.
+
+namespace solitaire {
+	// Fixed size record, stored as is in the cache files.
+	struct CachedResult {
+		std::uint64_t seed{ 0 };
+		std::uint64_t positionsTried{ 0 };
+		std::uint64_t maxStates{ 0 };      // Budget of the solve that found the result. 0 for infinite.
+		std::uint32_t configKey{ 0 };      // Ruleset and solver version the result was found with.
+		std::uint16_t solutionLength{ 0 };
+		SeedOutcome   outcome{ SeedOutcome::UNKNOWN };
+		std::uint8_t  reserved{ 0 };
+	};
+	static_assert(sizeof(CachedResult) == 32, "Cached results are stored as fixed size records.");
+
+	// Whether a cached result can be used instead of solving with a budget. Conclusive results always can.
+	// An unknown result is only reused if the new budget is no larger than the one that failed.
+	bool IsReusable(const CachedResult& result, u64 maxStates);
+
+	class ResultCache {
+	public:
+		ResultCache() = default;
+		ResultCache(const ResultCache&) = delete;
+		ResultCache& operator=(const ResultCache&) = delete;
+		~ResultCache();
+
+		// Open (or create) a cache directory. Returns false if there is an error.
+		bool open(const std::string& directory);
+
+		// Newest result for a seed, found with a config.
+		std::optional<CachedResult> find(u64 seed, u32 configKey) const;
+		// Add a result. It's visible to find straight away, and written to the journal on flush.
+		void add(const CachedResult& result);
+		// Append the added results to the journal. Returns false if there is an error.
+		bool flush();
+		// Merge the journal into the index. Returns false if there is an error (the journal is kept, so nothing is lost).
+		bool compact();
+
+		u64 size() const { return index_count_ + journal_.size(); }
+
+	private:
+		using Key = std::pair<u64, u32>;
+
+		bool _map_index();
+		const CachedResult* _index_begin() const;
+
+		std::string directory_;
+		MappedFile index_;
+		u64 index_count_{ 0 };
+		std::map<Key, CachedResult> journal_;
+		std::vector<CachedResult> unflushed_;
+	};
+}
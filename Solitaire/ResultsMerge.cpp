@@ -0,0 +1,275 @@
+#include "ResultsMerge.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <sstream>
+
+using namespace solitaire;
+
+namespace {
+	constexpr SeedOutcome OUTCOMES[] = { SeedOutcome::WIN, SeedOutcome::LOSE, SeedOutcome::UNKNOWN };
+
+	// Reads the lines of one sorted run.
+	class RunReader {
+	public:
+		RunReader(const std::string& path, SeedOutcome outcome, std::streamoff begin, std::streamoff end)
+			: file_(path, std::ios::binary), outcome_(outcome), offset_(begin), end_(end) {
+			file_.seekg(begin);
+		}
+
+		bool isOpen() const { return file_.is_open(); }
+		const SeedLine& current() const { return current_; }
+
+		// Returns false at the end of the run.
+		bool next() {
+			std::string line;
+			while (offset_ < end_ && std::getline(file_, line)) {
+				offset_ += static_cast<std::streamoff>(line.size()) + 1;
+				if (!line.empty() && line.back() == '\r')
+					line.pop_back();
+				if (ParseSeedLine(line, outcome_, current_))
+					return true;
+			}
+			return false;
+		}
+
+	private:
+		std::ifstream file_;
+		SeedOutcome outcome_;
+		std::streamoff offset_;
+		std::streamoff end_;
+		SeedLine current_;
+	};
+
+	// Merge runs, calling onGroup with all the lines for each seed in order. Returns false if a run can't be read.
+	template <typename Run, typename OnGroup>
+	bool _merge_runs(const std::vector<Run>& runs, OnGroup&& onGroup) {
+		std::vector<std::unique_ptr<RunReader>> readers;
+		readers.reserve(runs.size());
+		for (const Run& run : runs) {
+			readers.push_back(std::make_unique<RunReader>(run.path, run.outcome, run.begin, run.end));
+			if (!readers.back()->isOpen()) {
+				std::cerr << "ResultsMerger: Failed to open " << run.path << "\n";
+				return false;
+			}
+		}
+
+		auto later = [&readers](std::size_t lhs, std::size_t rhs) { return readers[lhs]->current().seed > readers[rhs]->current().seed; };
+		std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(later)> heap(later);
+		for (std::size_t i = 0; i < readers.size(); ++i) {
+			if (readers[i]->next())
+				heap.push(i);
+		}
+
+		std::vector<SeedLine> group;
+		while (!heap.empty()) {
+			const u64 seed = readers[heap.top()]->current().seed;
+			group.clear();
+			while (!heap.empty() && readers[heap.top()]->current().seed == seed) {
+				const std::size_t i = heap.top();
+				heap.pop();
+				group.push_back(readers[i]->current());
+				if (readers[i]->next())
+					heap.push(i);
+			}
+			onGroup(group);
+		}
+		return true;
+	}
+
+	// Picks the most conclusive line for a seed. Sets conflict if the seed is both won and lost.
+	const SeedLine& _resolve(const std::vector<SeedLine>& group, bool& out_conflict) {
+		const SeedLine* best = &group.front();
+		bool won = false, lost = false;
+		for (const SeedLine& line : group) {
+			won |= line.outcome == SeedOutcome::WIN;
+			lost |= line.outcome == SeedOutcome::LOSE;
+			if (best->outcome == SeedOutcome::UNKNOWN) {
+				if (line.outcome != SeedOutcome::UNKNOWN || line.positionsTried > best->positionsTried)
+					best = &line;
+			} else if (best->outcome == SeedOutcome::LOSE && line.outcome == SeedOutcome::WIN) {
+				best = &line;
+			}
+		}
+		out_conflict = won && lost;
+		return *best;
+	}
+}
+
+const char* solitaire::SeedOutcomeToStr(SeedOutcome outcome) {
+	switch (outcome) {
+	case SeedOutcome::WIN:     return "WIN";
+	case SeedOutcome::LOSE:    return "LOSE";
+	case SeedOutcome::UNKNOWN: return "UNKNOWN";
+	default:                   return "INVALID";
+	}
+}
+
+std::string_view solitaire::SeedFileName(SeedOutcome outcome) {
+	switch (outcome) {
+	case SeedOutcome::WIN:  return "winning_seeds.txt";
+	case SeedOutcome::LOSE: return "losing_seeds.txt";
+	default:                return "unknown_seeds.txt";
+	}
+}
+
+bool solitaire::ParseSeedLine(const std::string& line, SeedOutcome outcome, SeedLine& out_line) {
+	std::stringstream stream(line);
+	if (!(stream >> out_line.seed))
+		return false;
+	out_line.outcome = outcome;
+	out_line.line = line;
+	out_line.positionsTried = out_line.solutionLength = 0;
+	auto readField = [&line](std::string_view name, u64& out_value) {
+		if (const auto pos = line.find(name); pos != std::string::npos)
+			std::stringstream(line.substr(pos + name.size())) >> out_value;
+	};
+	readField("positions tried:", out_line.positionsTried);
+	readField("solution length:", out_line.solutionLength);
+	return true;
+}
+
+bool ResultsMerger::addDirectory(const std::string& path, bool recursive) {
+	namespace fs = std::filesystem;
+	std::error_code error;
+	auto addEntry = [this](const fs::directory_entry& entry) {
+		if (!entry.is_regular_file())
+			return true;
+		const std::string name = entry.path().filename().string();
+		for (SeedOutcome outcome : OUTCOMES) {
+			if (name == SeedFileName(outcome))
+				return addFile(entry.path().string(), outcome);
+		}
+		return true;
+	};
+	if (recursive) {
+		for (fs::recursive_directory_iterator it(path, error), end; !error && it != end; it.increment(error)) {
+			if (!addEntry(*it))
+				return false;
+		}
+	} else {
+		for (fs::directory_iterator it(path, error), end; !error && it != end; it.increment(error)) {
+			if (!addEntry(*it))
+				return false;
+		}
+	}
+	if (error) {
+		std::cerr << "ResultsMerger::addDirectory: Failed to read " << path << ": " << error.message() << "\n";
+		return false;
+	}
+	return true;
+}
+
+bool ResultsMerger::addFile(const std::string& path, SeedOutcome outcome) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		std::cerr << "ResultsMerger::addFile: Failed to open " << path << "\n";
+		return false;
+	}
+	// Split the file where the seeds stop increasing. Usually that's nowhere, or between separate runs appending to the same file.
+	std::string line;
+	std::streamoff offset = 0, runBegin = 0;
+	SeedLine parsed;
+	bool haveLast = false;
+	u64 last = 0;
+	while (std::getline(file, line)) {
+		if (ParseSeedLine(line, outcome, parsed)) {
+			if (haveLast && parsed.seed < last) {
+				runs_.push_back(Run{ path, outcome, runBegin, offset });
+				runBegin = offset;
+			}
+			haveLast = true;
+			last = parsed.seed;
+		}
+		offset += static_cast<std::streamoff>(line.size()) + 1;
+	}
+	if (haveLast)
+		runs_.push_back(Run{ path, outcome, runBegin, offset });
+	return true;
+}
+
+bool ResultsMerger::_reduce_runs(SeedOutcome outcome) {
+	// Merge the first MAX_OPEN_RUNS runs with this outcome into one temporary file, keeping a line per seed.
+	std::vector<Run> group;
+	for (auto it = runs_.begin(); it != runs_.end() && group.size() < MAX_OPEN_RUNS;) {
+		if (it->outcome == outcome) {
+			group.push_back(*it);
+			it = runs_.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	std::error_code error;
+	const auto tempDir = std::filesystem::temp_directory_path(error);
+	if (error) {
+		std::cerr << "ResultsMerger: No temporary directory to merge in: " << error.message() << "\n";
+		return false;
+	}
+	std::stringstream name;
+	name << "results_merge_" << std::chrono::system_clock::now().time_since_epoch().count() << "_" << temp_files_.size() << ".txt";
+	const std::string tempPath = (tempDir / name.str()).string();
+	temp_files_.push_back(tempPath);
+
+	std::ofstream temp(tempPath, std::ios::binary | std::ios::trunc);
+	if (!temp.is_open()) {
+		std::cerr << "ResultsMerger: Failed to create " << tempPath << "\n";
+		return false;
+	}
+	auto writeSeed = [this, &temp](const std::vector<SeedLine>& lines) {
+		bool conflict;
+		temp << _resolve(lines, conflict).line << "\n";
+		reduced_duplicates_ += lines.size() - 1;
+	};
+	if (!_merge_runs(group, writeSeed))
+		return false;
+	temp.close();
+	return addFile(tempPath, outcome);
+}
+
+bool ResultsMerger::merge(const SeedCallback& onSeed, const ConflictCallback& onConflict, MergeSummary& out_summary) {
+	out_summary = {};
+	reduced_duplicates_ = 0;
+	bool ok = true;
+	while (ok && runs_.size() > MAX_OPEN_RUNS) {
+		// Reduce the outcome with the most runs. Conflicts are between outcomes, so they are all still found in the final merge.
+		SeedOutcome most = SeedOutcome::WIN;
+		std::size_t mostRuns = 0;
+		for (SeedOutcome outcome : OUTCOMES) {
+			const auto count = static_cast<std::size_t>(std::count_if(runs_.begin(), runs_.end(), [outcome](const Run& r) { return r.outcome == outcome; }));
+			if (count > mostRuns) {
+				most = outcome;
+				mostRuns = count;
+			}
+		}
+		ok = _reduce_runs(most);
+	}
+
+	if (ok) {
+		ok = _merge_runs(runs_, [&](const std::vector<SeedLine>& lines) {
+			bool conflict;
+			const SeedLine& result = _resolve(lines, conflict);
+			++out_summary.seeds;
+			out_summary.duplicates += lines.size() - 1;
+			if (conflict) {
+				++out_summary.conflicts;
+				onConflict(lines);
+			}
+			onSeed(result);
+		});
+	}
+
+	for (const std::string& path : temp_files_) {
+		std::error_code error;
+		std::filesystem::remove(path, error);
+	}
+	temp_files_.clear();
+	runs_.clear();
+	out_summary.duplicates += reduced_duplicates_;
+	return ok;
+}
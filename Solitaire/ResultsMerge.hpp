@@ -0,0 +1,75 @@
+#pragma once
+
+#include "units.hpp"
+
+#include <functional>
+#include <ios>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Streaming merge of the seed files written by the batch runner (winning/losing/unknown_seeds.txt).
+// Batches are written sorted by seed, so every file is a series of sorted runs. The runs are merged k-ways, reading a line
+// at a time from each, so memory use depends on the number of runs rather than the number of seeds.
+
+namespace solitaire {
+	enum class SeedOutcome : u8 {
+		WIN,
+		LOSE,
+		UNKNOWN,
+	};
+	const char* SeedOutcomeToStr(SeedOutcome outcome);
+	// Name of the seed file for an outcome, EG "winning_seeds.txt".
+	std::string_view SeedFileName(SeedOutcome outcome);
+
+	// One line of a seed file: "<seed> (positions tried: <n>[, solution length: <n>])".
+	struct SeedLine {
+		u64 seed{ 0 };
+		SeedOutcome outcome{ SeedOutcome::UNKNOWN };
+		u64 positionsTried{ 0 };
+		u64 solutionLength{ 0 };
+		std::string line;
+	};
+	// Returns false if the line doesn't start with a seed.
+	bool ParseSeedLine(const std::string& line, SeedOutcome outcome, SeedLine& out_line);
+
+	struct MergeSummary {
+		u64 seeds{ 0 };
+		u64 duplicates{ 0 }; // Extra lines for seeds that were already seen.
+		u64 conflicts{ 0 };  // Seeds that are both won and lost.
+	};
+
+	class ResultsMerger {
+	public:
+		// Called once per seed, in order, with its most conclusive result: WIN or LOSE over UNKNOWN, and the UNKNOWN that tried the most positions.
+		// A seed that is both won and lost is a conflict, and the WIN is used (it has a solution that can be checked).
+		using SeedCallback = std::function<void(const SeedLine& result)>;
+		// Called for every line of a conflicting seed.
+		using ConflictCallback = std::function<void(const std::vector<SeedLine>& lines)>;
+
+		// Add the seed files in a directory (and its subdirectories, if recursive). Returns false if it can't be read.
+		bool addDirectory(const std::string& path, bool recursive = false);
+		// Add a seed file. Returns false if it can't be read.
+		bool addFile(const std::string& path, SeedOutcome outcome);
+
+		// Returns false if there is an error reading the inputs (some seeds may have already been passed on).
+		bool merge(const SeedCallback& onSeed, const ConflictCallback& onConflict, MergeSummary& out_summary);
+
+		// Limit on files open at once. With more runs than this, groups of runs are first merged into temporary files.
+		static constexpr std::size_t MAX_OPEN_RUNS = 256;
+
+	private:
+		struct Run {
+			std::string path;
+			SeedOutcome outcome;
+			std::streamoff begin;
+			std::streamoff end;
+		};
+
+		bool _reduce_runs(SeedOutcome outcome);
+
+		std::vector<Run> runs_;
+		std::vector<std::string> temp_files_;
+		u64 reduced_duplicates_ = 0;
+	};
+}
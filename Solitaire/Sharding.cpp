@@ -0,0 +1,187 @@
+#include "Sharding.hpp"
+
+#include <charconv>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+using namespace solitaire;
+
+namespace {
+	// Holds an exclusive lock on a file while it is open. Opens for reading and appending, creating the file if needed.
+	class LockedFile {
+	public:
+		explicit LockedFile(const std::string& path) {
+#ifdef _WIN32
+			handle_ = ::CreateFileA(path.c_str(), GENERIC_READ | FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (handle_ == INVALID_HANDLE_VALUE)
+				return;
+			OVERLAPPED overlapped{};
+			locked_ = ::LockFileEx(handle_, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &overlapped) != 0;
+#else
+			fd_ = ::open(path.c_str(), O_RDWR | O_APPEND | O_CREAT, 0644);
+			if (fd_ < 0)
+				return;
+			locked_ = ::flock(fd_, LOCK_EX) == 0;
+#endif
+		}
+		~LockedFile() {
+#ifdef _WIN32
+			if (handle_ != INVALID_HANDLE_VALUE) {
+				if (locked_) {
+					OVERLAPPED overlapped{};
+					::UnlockFileEx(handle_, 0, MAXDWORD, MAXDWORD, &overlapped);
+				}
+				::CloseHandle(handle_);
+			}
+#else
+			if (fd_ >= 0) {
+				if (locked_)
+					::flock(fd_, LOCK_UN);
+				::close(fd_);
+			}
+#endif
+		}
+		LockedFile(const LockedFile&) = delete;
+		LockedFile& operator=(const LockedFile&) = delete;
+
+		bool isLocked() const { return locked_; }
+
+		bool readAll(std::string& out_contents) {
+			out_contents.clear();
+			char buffer[4096];
+			for (;;) {
+#ifdef _WIN32
+				DWORD read = 0;
+				if (!::ReadFile(handle_, buffer, sizeof(buffer), &read, nullptr))
+					return false;
+#else
+				const ssize_t read = ::read(fd_, buffer, sizeof(buffer));
+				if (read < 0)
+					return false;
+#endif
+				if (read == 0)
+					return true;
+				out_contents.append(buffer, static_cast<std::size_t>(read));
+			}
+		}
+
+		bool append(const std::string& text) {
+#ifdef _WIN32
+			DWORD written = 0;
+			return ::WriteFile(handle_, text.data(), static_cast<DWORD>(text.size()), &written, nullptr) && written == text.size();
+#else
+			return ::write(fd_, text.data(), text.size()) == static_cast<ssize_t>(text.size());
+#endif
+		}
+
+	private:
+#ifdef _WIN32
+		HANDLE handle_ = INVALID_HANDLE_VALUE;
+#else
+		int fd_ = -1;
+#endif
+		bool locked_ = false;
+	};
+
+	u64 _now_seconds() {
+		return static_cast<u64>(std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+	}
+}
+
+bool solitaire::ParseShardSpec(std::string_view str, ShardSpec& out_spec) {
+	const auto slash = str.find('/');
+	if (slash == std::string_view::npos)
+		return false;
+	ShardSpec spec;
+	const auto index = std::from_chars(str.data(), str.data() + slash, spec.index);
+	const auto count = std::from_chars(str.data() + slash + 1, str.data() + str.size(), spec.count);
+	if (index.ec != std::errc() || index.ptr != str.data() + slash || count.ec != std::errc() || count.ptr != str.data() + str.size())
+		return false;
+	if (spec.count == 0 || spec.index >= spec.count)
+		return false;
+	out_spec = spec;
+	return true;
+}
+
+std::string LeaseFile::_header() const {
+	std::stringstream header;
+	header << "sweep first-seed " << first_seed_ << " batch-size " << batch_size_ << " seed-file " << (seed_file_path_.empty() ? "-" : seed_file_path_);
+	return header.str();
+}
+
+bool LeaseFile::acquire(u64& out_batch) {
+	LockedFile file(path_);
+	std::string contents;
+	if (!file.isLocked() || !file.readAll(contents)) {
+		std::cerr << "LeaseFile::acquire: Failed to lock and read lease file: " << path_ << "\n";
+		return false;
+	}
+
+	std::stringstream log(contents);
+	std::string line;
+	if (!std::getline(log, line)) {
+		if (!file.append(_header() + "\n")) {
+			std::cerr << "LeaseFile::acquire: Failed to write lease file: " << path_ << "\n";
+			return false;
+		}
+	} else if (line != _header()) {
+		std::cerr << "LeaseFile::acquire: Lease file is for a different sweep (" << line << ").\n";
+		return false;
+	}
+
+	std::map<u64, u64> leaseTimes; // Batch -> latest lease time.
+	std::set<u64> done;
+	while (std::getline(log, line)) {
+		std::stringstream entry(line);
+		std::string type;
+		u64 batch, time{ 0 };
+		if (!(entry >> type >> batch))
+			continue;
+		if (type == "lease" && entry >> time)
+			leaseTimes[batch] = time;
+		else if (type == "done")
+			done.insert(batch);
+	}
+
+	const u64 now = _now_seconds();
+	out_batch = leaseTimes.empty() ? 0 : leaseTimes.rbegin()->first + 1;
+	if (timeout_seconds_ > 0) {
+		for (const auto& [batch, time] : leaseTimes) {
+			if (done.count(batch) == 0 && now - time >= timeout_seconds_) {
+				out_batch = batch; // Take over an abandoned batch.
+				break;
+			}
+		}
+	}
+
+	std::stringstream lease;
+	lease << "lease " << out_batch << " " << now << "\n";
+	if (!file.append(lease.str())) {
+		std::cerr << "LeaseFile::acquire: Failed to write lease file: " << path_ << "\n";
+		return false;
+	}
+	return true;
+}
+
+bool LeaseFile::complete(u64 batch) {
+	LockedFile file(path_);
+	std::stringstream entry;
+	entry << "done " << batch << "\n";
+	if (!file.isLocked() || !file.append(entry.str())) {
+		std::cerr << "LeaseFile::complete: Failed to write lease file: " << path_ << "\n";
+		return false;
+	}
+	return true;
+}
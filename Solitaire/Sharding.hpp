@@ -0,0 +1,44 @@
+#pragma once
+
+#include "units.hpp"
+
+#include <string>
+#include <string_view>
+
+// Splitting a sweep over seeds between several runs (EG on different machines).
+// A sweep is numbered in batches from its first seed: batch b is seeds [first + b * batchSize, first + (b + 1) * batchSize),
+// or the same span of lines from the first seed in a seed file. Runs pick batches by shard or lease, so they never overlap.
+
+namespace solitaire {
+	// Run every Nth batch, starting from batch i.
+	struct ShardSpec {
+		u32 index{ 0 };
+		u32 count{ 1 };
+	};
+	// Parse "i/N", with i in [0, N). Returns false if malformed.
+	bool ParseShardSpec(std::string_view str, ShardSpec& out_spec);
+
+	// Hands out batches to any number of runs through a shared file, which is locked while it is read and updated.
+	// The file is a log: a header with the sweep's parameters, then "lease <batch> <time>" and "done <batch>" lines.
+	// With a timeout, leases that haven't been finished in that many seconds are handed out again, so a run that dies
+	// doesn't leave a gap (if the first run does finish, the batch is in two outputs, which merging removes).
+	class LeaseFile {
+	public:
+		LeaseFile(std::string path, u64 firstSeed, u32 batchSize, std::string seedFilePath, u64 timeoutSeconds = 0)
+			: path_(std::move(path)), first_seed_(firstSeed), batch_size_(batchSize), seed_file_path_(std::move(seedFilePath)), timeout_seconds_(timeoutSeconds) {}
+
+		// Lease the next batch to run. Returns false if there is an error, or the file is for a different sweep.
+		bool acquire(u64& out_batch);
+		// Record a leased batch as finished, once its results are written. Returns false if there is an error.
+		bool complete(u64 batch);
+
+	private:
+		std::string _header() const;
+
+		std::string path_;
+		u64 first_seed_;
+		u32 batch_size_;
+		std::string seed_file_path_;
+		u64 timeout_seconds_;
+	};
+}
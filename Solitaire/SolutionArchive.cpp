@@ -0,0 +1,34 @@
+#include "SolutionArchive.hpp"
+
+#include <iomanip>
+#include <sstream>
+
+using namespace solitaire;
+
+void solitaire::WriteSolution(std::ostream& output, u64 seed, const MoveList& solution) {
+	output << std::setfill('0') << std::setw(10) << seed << std::hex;
+	for (const Move& move : solution)
+		output << " " << move.getCode();
+	output << std::dec << "\n";
+}
+
+bool solitaire::ParseSolution(const std::string& line, u64& out_seed, MoveList& out_solution) {
+	std::stringstream stream(line);
+	if (!(stream >> out_seed))
+		return false;
+	out_solution.clear();
+	std::uint32_t code;
+	while (stream >> std::hex >> code)
+		out_solution.push_back(Move::FromCode(code));
+	return stream.eof();
+}
+
+bool solitaire::FindSolution(std::istream& archive, u64 seed, MoveList& out_solution) {
+	std::string line;
+	u64 lineSeed;
+	while (std::getline(archive, line)) {
+		if (ParseSolution(line, lineSeed, out_solution) && lineSeed == seed)
+			return true;
+	}
+	return false;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "units.hpp"
+#include "Move.hpp"
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+// Compact storage for winning solutions: one line per seed, with each move as its packed code in hex.
+// EG "0000000042 1a2c3 4b01 ...". Lines are appended a batch at a time, like the seed files.
+
+namespace solitaire {
+	constexpr std::string_view SOLUTIONS_ARCHIVE_FILE = "solutions.txt";
+
+	void WriteSolution(std::ostream& output, u64 seed, const MoveList& solution);
+	// Returns false if the line is malformed.
+	bool ParseSolution(const std::string& line, u64& out_seed, MoveList& out_solution);
+	// Find a seed's solution in an archive. Returns false if it isn't there.
+	bool FindSolution(std::istream& archive, u64 seed, MoveList& out_solution);
+}
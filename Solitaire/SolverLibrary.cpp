@@ -0,0 +1,155 @@
+#include "SolverLibrary.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "threadpool/threadpool/Threadpool.hpp"
+
+using namespace solitaire;
+
+// Threads and solvers are kept between batches, so each batch doesn't pay to set them up (EG the solvers' state tables).
+struct BatchSolver::Workers {
+	Workers(unsigned int numThreads) : pool(numThreads) {}
+
+	template <typename Rules>
+	std::vector<KlondikeSolver<Rules>>& solvers() {
+		if constexpr (std::is_same_v<Rules, DrawOneRules>)
+			return drawOne;
+		else
+			return drawThree;
+	}
+
+	Threadpool pool;
+	std::mutex batchMutex;
+	std::vector<KlondikeSolver<DrawOneRules>> drawOne;
+	std::vector<KlondikeSolver<DrawThreeRules>> drawThree;
+};
+
+bool solitaire::IsValidDeck(const Deck& deck) {
+	if (deck.size() != CARDS_PER_DECK)
+		return false;
+	CardMask seen = 0;
+	for (const Card& c : deck) {
+		if (toUType(c.getSuit()) >= toUType(Suit::TOTAL_SUITS) || c.getRank() < 1 || c.getRank() > CARDS_PER_SUIT || (seen & CardBit(c)))
+			return false;
+		seen |= CardBit(c);
+	}
+	return true;
+}
+
+BatchSolver::BatchSolver(SolveOptions options) : options_(std::move(options)) {
+	const unsigned int numThreads = options_.numThreads > 0 ? options_.numThreads : std::max(std::thread::hardware_concurrency(), 1u);
+	options_.gamesPerThread = std::max<u8>(options_.gamesPerThread, 1);
+	workers_ = std::make_unique<Workers>(numThreads);
+	auto makeSolvers = [this, numThreads](auto& solvers) {
+		using Solver = typename std::decay_t<decltype(solvers)>::value_type;
+		solvers = std::vector<Solver>(numThreads * options_.gamesPerThread, Solver(options_.maxStates, options_.priorities));
+		for (auto& solver : solvers)
+			solver.setAutoMoveRules(options_.autoMoveRules);
+	};
+	switch (options_.drawCount) {
+	case 1: makeSolvers(workers_->drawOne); break;
+	case 3: makeSolvers(workers_->drawThree); break;
+	default: break; // Reported when solving.
+	}
+}
+
+BatchSolver::~BatchSolver() = default;
+
+bool BatchSolver::solveSeeds(const u64* seeds, std::size_t count, const ResultCallback& onResult) {
+	auto setUp = [seeds](auto& solver, std::size_t index) {
+		solver.setSeed(seeds[index]);
+	};
+	return _solve(count, setUp, onResult);
+}
+
+bool BatchSolver::solveSeeds(const u64* seeds, std::size_t count, GameResult* out_results) {
+	return solveSeeds(seeds, count, [out_results](std::size_t index, GameResult& result) { out_results[index] = std::move(result); });
+}
+
+bool BatchSolver::solveDecks(const Deck* decks, std::size_t count, const ResultCallback& onResult) {
+	for (std::size_t i = 0; i < count; ++i) {
+		if (!IsValidDeck(decks[i])) {
+			std::cerr << "BatchSolver::solveDecks: Deck " << i << " doesn't hold each card exactly once.\n";
+			return false;
+		}
+	}
+	auto setUp = [decks](auto& solver, std::size_t index) {
+		typename std::decay_t<decltype(solver)>::Game game(index);
+		game.setUpGame(decks[index]);
+		solver.setGame(game);
+	};
+	return _solve(count, setUp, onResult);
+}
+
+bool BatchSolver::solveDecks(const Deck* decks, std::size_t count, GameResult* out_results) {
+	return solveDecks(decks, count, [out_results](std::size_t index, GameResult& result) { out_results[index] = std::move(result); });
+}
+
+template <typename SetUp>
+bool BatchSolver::_solve(std::size_t count, const SetUp& setUp, const ResultCallback& onResult) {
+	if (!onResult) {
+		std::cerr << "BatchSolver: No result callback given.\n";
+		return false;
+	}
+	switch (options_.drawCount) {
+	case 1: _solve<DrawOneRules>(count, setUp, onResult); return true;
+	case 3: _solve<DrawThreeRules>(count, setUp, onResult); return true;
+	default:
+		std::cerr << "BatchSolver: Unsupported stock draw count (" << static_cast<u32>(options_.drawCount) << ").\n";
+		return false;
+	}
+}
+
+template <typename Rules, typename SetUp>
+void BatchSolver::_solve(std::size_t count, const SetUp& setUp, const ResultCallback& onResult) {
+	std::lock_guard<std::mutex> lock(workers_->batchMutex);
+	auto& solvers = workers_->solvers<Rules>();
+	std::atomic<std::size_t> next{ 0 };
+	const u64 sliceStates = options_.gamesPerThread > 1 ? options_.sliceStates : 0;
+	// Each thread round-robins its games, a slice each, taking a new game whenever one finishes.
+	auto task = [&](KlondikeSolver<Rules>* threadSolvers) {
+		std::vector<std::pair<KlondikeSolver<Rules>*, std::size_t>> open; // Solver, and the index of the game it's searching.
+		for (u8 s = 0; s < options_.gamesPerThread; ++s) {
+			const std::size_t i = next++;
+			if (i >= count)
+				break;
+			setUp(threadSolvers[s], i);
+			open.emplace_back(&threadSolvers[s], i);
+		}
+		std::size_t k = 0;
+		while (!open.empty()) {
+			if (k >= open.size())
+				k = 0;
+			auto& [solver, index] = open[k];
+			if (std::optional<GameResult> result = solver->solveFor(sliceStates)) {
+				if (!options_.keepSolutions)
+					result->solution = MoveList();
+				onResult(index, *result);
+				index = next++;
+				if (index < count) {
+					setUp(*solver, index);
+				} else {
+					open[k] = open.back(); // The last game takes this one's turn.
+					open.pop_back();
+					continue;
+				}
+			}
+			++k;
+		}
+	};
+	std::vector<std::future<void>> threads;
+	threads.reserve(solvers.size() / options_.gamesPerThread);
+	for (std::size_t s = 0; s < solvers.size(); s += options_.gamesPerThread)
+		threads.push_back(workers_->pool.add(task, &solvers[s]));
+	for (auto& thread : threads)
+		thread.get();
+}
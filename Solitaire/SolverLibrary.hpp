@@ -0,0 +1,65 @@
+#pragma once
+
+#include "units.hpp"
+#include "AutoMoveRules.hpp"
+#include "Deck.hpp"
+#include "KlondikeSolver.hpp"
+#include "MovePriorities.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+// In-process API for solving batches of games, for embedding the solver (see solitaire.h for the C ABI).
+// Games are solved on the library's own threads. Results are handed back through a callback or an output array, and nothing is read
+// from or written to disk.
+
+namespace solitaire {
+	struct SolveOptions {
+		u64 maxStates{ 1000000 };   // 0 for infinite.
+		u8 numThreads{ 0 };         // 0 to auto-deduce.
+		u8 drawCount{ 3 };          // 1 or 3.
+		AutoMoveRuleSet autoMoveRules{ DEFAULT_AUTO_MOVE_RULES };
+		MovePriorities priorities;
+		bool keepSolutions{ true }; // Drop solutions before results are handed back, if they aren't needed.
+		// Games each thread keeps open at once, taking turns to search sliceStates positions each. Hard games then hold up their thread's
+		// other games by a slice at a time, rather than until they finish. Each open game has its own solver (and state table).
+		u8 gamesPerThread{ 1 };
+		u64 sliceStates{ 10000 };
+	};
+
+	class BatchSolver {
+	public:
+		// Called once per game, from the solver threads, as each game finishes (so not in order). Index is the game's position in the input.
+		// Calls can be concurrent. The result can be moved from.
+		using ResultCallback = std::function<void(std::size_t index, GameResult& result)>;
+
+		BatchSolver(SolveOptions options = {});
+		~BatchSolver();
+		BatchSolver(const BatchSolver&) = delete;
+		BatchSolver& operator=(const BatchSolver&) = delete;
+
+		const SolveOptions& getOptions() const { return options_; }
+
+		// Each returns false without solving anything if the options or input are invalid. A batch runs at a time, so concurrent calls wait.
+		bool solveSeeds(const u64* seeds, std::size_t count, const ResultCallback& onResult);
+		bool solveSeeds(const u64* seeds, std::size_t count, GameResult* out_results);
+		// Solve dealt decks, in the order GenDeck returns them. Results get the deck's index as their seed.
+		bool solveDecks(const Deck* decks, std::size_t count, const ResultCallback& onResult);
+		bool solveDecks(const Deck* decks, std::size_t count, GameResult* out_results);
+
+	private:
+		struct Workers;
+
+		template <typename Rules, typename SetUp>
+		void _solve(std::size_t count, const SetUp& setUp, const ResultCallback& onResult);
+		template <typename SetUp>
+		bool _solve(std::size_t count, const SetUp& setUp, const ResultCallback& onResult);
+
+		SolveOptions options_;
+		std::unique_ptr<Workers> workers_;
+	};
+
+	// Whether a deck holds each card exactly once.
+	bool IsValidDeck(const Deck& deck);
+}
@@ -0,0 +1,187 @@
+#include "StateFilter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <utility>
+
+using namespace solitaire;
+
+namespace {
+	std::uint64_t _mix(std::uint64_t h) {
+		h ^= h >> 33;
+		h *= 0xFF51AFD7ED558CCDull;
+		h ^= h >> 33;
+		h *= 0xC4CEB9FE1A85EC53ull;
+		return h ^ (h >> 33);
+	}
+
+	std::uint64_t _hash_key(const StateTable::Key& key) {
+		std::uint64_t h = 0;
+		for (std::size_t i = 0; i < StateTable::KEY_SIZE; i += sizeof(std::uint64_t)) {
+			std::uint64_t word;
+			std::memcpy(&word, key.data() + i, sizeof(word));
+			h = _mix(h ^ word);
+		}
+		return h;
+	}
+
+	// False positive rate of a blocked filter with blocks of blockBits bits, averaging keysPerBlock keys of bitsPerKey bits each.
+	// Keys per block are Poisson distributed, and within a block it behaves as a plain Bloom filter.
+	double _false_positive_rate(double keysPerBlock, std::uint32_t bitsPerKey, std::size_t blockBits) {
+		double rate = 0;
+		double probability = std::exp(-keysPerBlock); // Of a block holding j keys.
+		const std::uint32_t maxKeys = static_cast<std::uint32_t>(keysPerBlock + 10 * std::sqrt(keysPerBlock) + 20);
+		for (std::uint32_t j = 0; j <= maxKeys; ++j) {
+			const double bitSet = 1 - std::pow(1 - 1.0 / blockBits, static_cast<double>(bitsPerKey) * j);
+			rate += probability * std::pow(bitSet, bitsPerKey);
+			probability *= keysPerBlock / (j + 1);
+		}
+		return rate;
+	}
+}
+
+StateFilter::StateFilter(std::size_t memoryBytes, double falsePositiveRate) {
+	if (memoryBytes < sizeof(Block) || !(falsePositiveRate > 0 && falsePositiveRate < 1))
+		return;
+	num_blocks_ = 1;
+	while (num_blocks_ * 2 * sizeof(Block) <= memoryBytes)
+		num_blocks_ *= 2;
+	// Pick the bits per key that let blocks hold the most keys before going over the false positive rate.
+	double bestKeysPerBlock = 0;
+	for (std::uint32_t k = 1; k <= 16; ++k) {
+		double low = 0, high = BLOCK_BITS;
+		for (u32 i = 0; i < 40; ++i) {
+			const double mid = (low + high) / 2;
+			(_false_positive_rate(mid, k, BLOCK_BITS) <= falsePositiveRate ? low : high) = mid;
+		}
+		if (low > bestKeysPerBlock) {
+			bestKeysPerBlock = low;
+			bits_per_key_ = k;
+		}
+	}
+	capacity_ = static_cast<std::size_t>(bestKeysPerBlock * num_blocks_);
+}
+
+StateFilter::StateFilter(const StateFilter& o) noexcept : num_blocks_(o.num_blocks_), bits_per_key_(o.bits_per_key_), capacity_(o.capacity_) {}
+
+StateFilter::StateFilter(StateFilter&& o) noexcept
+	: memory_(std::exchange(o.memory_, {})), blocks_(std::exchange(o.blocks_, nullptr)), num_blocks_(std::exchange(o.num_blocks_, 0)),
+	bits_per_key_(std::exchange(o.bits_per_key_, 0)), capacity_(std::exchange(o.capacity_, 0)), size_(std::exchange(o.size_, 0)),
+	touched_(std::move(o.touched_)), touched_all_(std::exchange(o.touched_all_, false)) {}
+
+StateFilter& StateFilter::operator=(const StateFilter& o) noexcept {
+	if (this != &o) {
+		release();
+		num_blocks_ = o.num_blocks_;
+		bits_per_key_ = o.bits_per_key_;
+		capacity_ = o.capacity_;
+	}
+	return *this;
+}
+
+StateFilter& StateFilter::operator=(StateFilter&& o) noexcept {
+	if (this != &o) {
+		release();
+		memory_ = std::exchange(o.memory_, {});
+		blocks_ = std::exchange(o.blocks_, nullptr);
+		num_blocks_ = std::exchange(o.num_blocks_, 0);
+		bits_per_key_ = std::exchange(o.bits_per_key_, 0);
+		capacity_ = std::exchange(o.capacity_, 0);
+		size_ = std::exchange(o.size_, 0);
+		touched_ = std::move(o.touched_);
+		touched_all_ = std::exchange(o.touched_all_, false);
+	}
+	return *this;
+}
+
+StateFilter::~StateFilter() {
+	release();
+}
+
+bool StateFilter::insert(const StateTable::Key& key) {
+	if (!blocks_ && !_allocate())
+		throw std::bad_alloc();
+
+	std::uint64_t masks[8];
+	const std::size_t blockIndex = _key_bits(key, masks);
+	Block& block = blocks_[blockIndex];
+	bool isNew = false;
+	for (std::size_t w = 0; w < 8; ++w) {
+		isNew = isNew || (block.words[w] & masks[w]) != masks[w];
+		block.words[w] |= masks[w];
+	}
+	if (!isNew)
+		return false;
+	++size_;
+	if (!touched_all_) {
+		if (touched_.size() < MAX_TOUCHED_BLOCKS)
+			touched_.push_back(blockIndex);
+		else
+			touched_all_ = true;
+	}
+	return true;
+}
+
+bool StateFilter::contains(const StateTable::Key& key) const {
+	if (!blocks_)
+		return false;
+	std::uint64_t masks[8];
+	const Block& block = blocks_[_key_bits(key, masks)];
+	for (std::size_t w = 0; w < 8; ++w) {
+		if ((block.words[w] & masks[w]) != masks[w])
+			return false;
+	}
+	return true;
+}
+
+void StateFilter::clear() {
+	if (blocks_) {
+		if (touched_all_)
+			std::memset(static_cast<void*>(blocks_), 0, num_blocks_ * sizeof(Block));
+		else {
+			for (std::size_t i : touched_)
+				blocks_[i] = Block{};
+		}
+	}
+	touched_.clear();
+	touched_all_ = false;
+	size_ = 0;
+}
+
+void StateFilter::release() {
+	FreePages(memory_);
+	blocks_ = nullptr;
+	size_ = 0;
+	touched_.clear();
+	touched_all_ = false;
+}
+
+bool StateFilter::_allocate() {
+	memory_ = AllocatePages(num_blocks_ * sizeof(Block));
+	if (!memory_.data) {
+		std::cerr << "StateFilter: Failed to allocate " << num_blocks_ * sizeof(Block) << " bytes.\n";
+		return false;
+	}
+	// Pages come zeroed, so every block starts out empty.
+	blocks_ = static_cast<Block*>(memory_.data);
+	touched_.reserve(MAX_TOUCHED_BLOCKS);
+	return true;
+}
+
+std::size_t StateFilter::_key_bits(const StateTable::Key& key, std::uint64_t (&out_masks)[8]) const {
+	// The low bits pick the block. The bits to set in it are taken 9 at a time from further mixes of the hash.
+	static_assert(BLOCK_BITS == 512, "Bit positions are taken 9 bits at a time.");
+	std::uint64_t h = _hash_key(key);
+	const std::size_t blockIndex = static_cast<std::size_t>(h) & (num_blocks_ - 1);
+	std::fill(std::begin(out_masks), std::end(out_masks), 0);
+	for (std::uint32_t i = 0; i < bits_per_key_; ++i) {
+		if (i % 7 == 0)
+			h = _mix(h);
+		const std::uint32_t bit = static_cast<std::uint32_t>(h >> (i % 7 * 9)) % BLOCK_BITS;
+		out_masks[bit / 64] |= std::uint64_t{ 1 } << (bit % 64);
+	}
+	return blockIndex;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Platform.hpp"
+#include "StateTable.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace solitaire {
+	// Approximate set of seen game states: a blocked Bloom filter, with each key's bits in one cache line.
+	// A key that was never inserted can be reported as seen (at about the configured false positive rate, until the filter is full),
+	// but an inserted key is always reported as seen. Holds many more states in the same memory than a StateTable.
+	// Like StateTable, memory is allocated on first insert (from the thread using it), and kept until released.
+	class StateFilter {
+	public:
+		StateFilter() = default;
+		// Filter sized to a memory budget. Bits per key are picked from the false positive rate, which sets how many keys it holds.
+		StateFilter(std::size_t memoryBytes, double falsePositiveRate);
+		// Copies start out empty, with the same sizing.
+		StateFilter(const StateFilter& o) noexcept;
+		StateFilter(StateFilter&& o) noexcept;
+		StateFilter& operator=(const StateFilter& o) noexcept;
+		StateFilter& operator=(StateFilter&& o) noexcept;
+		~StateFilter();
+
+		// Whether the filter was given any memory to use.
+		bool isEnabled() const { return num_blocks_ > 0; }
+		// Returns true if the key was (certainly) not already in the filter.
+		bool insert(const StateTable::Key& key);
+		// Whether the key may be in the filter. Always true for inserted keys, and true for others at about the false positive rate.
+		bool contains(const StateTable::Key& key) const;
+		// Remove all keys, keeping the memory.
+		void clear();
+		// Remove all keys, and free the memory.
+		void release();
+
+		std::size_t size() const { return size_; }
+		// Keys the filter holds before its false positive rate rises past the one it was sized for.
+		std::size_t capacity() const { return capacity_; }
+		bool isFull() const { return size_ >= capacity_; }
+		PageKind getPageKind() const { return memory_.kind; }
+
+	private:
+		struct alignas(64) Block {
+			std::uint64_t words[8];
+		};
+		static_assert(sizeof(Block) == 64, "Blocks should fill a cache line.");
+		static constexpr std::size_t BLOCK_BITS = sizeof(Block) * 8;
+		// Blocks to remember setting bits in, so clearing a lightly used filter doesn't have to zero all of it.
+		static constexpr std::size_t MAX_TOUCHED_BLOCKS = 1 << 16;
+
+		bool _allocate();
+		// The key's block, and the bits to set in each of its words.
+		std::size_t _key_bits(const StateTable::Key& key, std::uint64_t (&out_masks)[8]) const;
+
+		PageAllocation memory_;
+		Block* blocks_ = nullptr;
+		std::size_t num_blocks_ = 0; // A power of two.
+		std::uint32_t bits_per_key_ = 0;
+		std::size_t capacity_ = 0;
+		std::size_t size_ = 0;
+		std::vector<std::size_t> touched_; // Blocks written since the last clear, until there are too many to track.
+		bool touched_all_ = false;
+	};
+}
@@ -0,0 +1,294 @@
+#include "StateStore.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+using namespace solitaire;
+
+namespace {
+	constexpr const char* RUN_PREFIX = "run_";
+	constexpr const char* RUN_EXTENSION = ".bin";
+
+	struct FileHeader {
+		char magic[8];
+		std::uint32_t version{ 1 };
+		std::uint32_t recordSize{ StateTable::KEY_SIZE };
+	};
+	static_assert(sizeof(FileHeader) == 16);
+	constexpr FileHeader RUN_HEADER{ { 'S', 'O', 'L', 'S', 'T', 'A', 'T', 'E' } };
+	constexpr FileHeader CHECKPOINT_HEADER{ { 'S', 'O', 'L', 'C', 'H', 'K', 'P', 'T' } };
+
+	bool _is_header(const FileHeader& header, const FileHeader& expected) {
+		return std::memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0 && header.version == expected.version && header.recordSize == expected.recordSize;
+	}
+
+	bool _is_run_file(const std::filesystem::path& path) {
+		const std::string name = path.filename().string();
+		return name.rfind(RUN_PREFIX, 0) == 0 && path.extension() == RUN_EXTENSION;
+	}
+
+	template <typename T>
+	void _write_value(std::ostream& out, const T& value) {
+		out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+	}
+
+	template <typename T>
+	bool _read_value(std::istream& in, T& out_value) {
+		return static_cast<bool>(in.read(reinterpret_cast<char*>(&out_value), sizeof(out_value)));
+	}
+
+	const StateTable::Key* _run_keys(const MappedFile& file) {
+		return reinterpret_cast<const StateTable::Key*>(static_cast<const char*>(file.data) + sizeof(FileHeader));
+	}
+}
+
+StateStore::Run::~Run() {
+	UnmapFile(file);
+}
+
+StateStore::~StateStore() = default;
+
+bool StateStore::open(const std::string& directory, std::size_t memoryBytes) {
+	directory_ = directory;
+	if (!directory_.empty() && directory_.back() != '/' && directory_.back() != '\\')
+		directory_ += '/';
+	std::error_code error;
+	std::filesystem::create_directories(directory_, error);
+	if (error) {
+		std::cerr << "StateStore::open: Failed to create store directory: " << directory_ << "\n";
+		return false;
+	}
+	runs_.clear();
+	disk_size_ = 0;
+	hot_.release();
+	checkpointed_.clear();
+	retired_.clear();
+
+	// Stop the table short of growing past half the budget (it grows once 60% full).
+	std::size_t slots = std::size_t{ 1 } << 14;
+	while (slots * 2 * StateTable::SLOT_SIZE <= memoryBytes / 2)
+		slots *= 2;
+	hot_limit_ = slots * 3 / 5 - 1;
+	filter_keys_per_byte_ = static_cast<double>(StateFilter(1 << 20, RUN_FILTER_FALSE_POSITIVES).capacity()) / (1 << 20);
+	return true;
+}
+
+bool StateStore::insert(const StateTable::Key& key) {
+	if (hot_.contains(key))
+		return false;
+	for (const auto& run : runs_) {
+		if (run->filter.contains(key) && _in_run(*run, key))
+			return false;
+	}
+	if (hot_.size() >= hot_limit_ && !_spill())
+		throw std::runtime_error("StateStore: Failed to write seen states to disk.");
+	hot_.insert(key);
+	return true;
+}
+
+void StateStore::clear() {
+	hot_.clear();
+	runs_.clear();
+	disk_size_ = 0;
+	checkpointed_.clear();
+	retired_.clear();
+	// Remove every run, including any left by a search that was never checkpointed.
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator(directory_, error)) {
+		if (_is_run_file(entry.path()))
+			_remove_file(entry.path().filename().string());
+	}
+}
+
+bool StateStore::writeCheckpoint(const std::string& path, const std::string& searchState) {
+	if (hot_.size() > 0 && !_spill())
+		return false;
+
+	// Write the new checkpoint beside the old one, and replace it once it's complete.
+	const std::string tempPath = path + ".tmp";
+	std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		std::cerr << "StateStore::writeCheckpoint: Failed to open checkpoint file: " << tempPath << "\n";
+		return false;
+	}
+	_write_value(file, CHECKPOINT_HEADER);
+	_write_value(file, next_run_id_);
+	_write_value(file, static_cast<u64>(runs_.size()));
+	for (const auto& run : runs_) {
+		_write_value(file, static_cast<u64>(run->name.size()));
+		file.write(run->name.data(), static_cast<std::streamsize>(run->name.size()));
+	}
+	_write_value(file, static_cast<u64>(searchState.size()));
+	file.write(searchState.data(), static_cast<std::streamsize>(searchState.size()));
+	file.close();
+	std::error_code error;
+	if (file)
+		std::filesystem::rename(tempPath, path, error);
+	if (!file || error) {
+		std::cerr << "StateStore::writeCheckpoint: Failed to write checkpoint: " << path << "\n";
+		return false;
+	}
+
+	for (const std::string& name : retired_)
+		_remove_file(name);
+	retired_.clear();
+	checkpointed_.clear();
+	for (const auto& run : runs_)
+		checkpointed_.push_back(run->name);
+	return true;
+}
+
+bool StateStore::readCheckpoint(const std::string& path, std::string& out_search_state) {
+	std::ifstream file(path, std::ios::binary);
+	FileHeader header;
+	if (!file.is_open() || !_read_value(file, header) || !_is_header(header, CHECKPOINT_HEADER)) {
+		std::cerr << "StateStore::readCheckpoint: Unrecognised checkpoint: " << path << "\n";
+		return false;
+	}
+	hot_.clear();
+	runs_.clear();
+	disk_size_ = 0;
+	retired_.clear();
+	checkpointed_.clear();
+
+	u64 numRuns = 0, stateSize = 0;
+	bool valid = _read_value(file, next_run_id_) && _read_value(file, numRuns);
+	for (u64 i = 0; valid && i < numRuns; ++i) {
+		u64 nameSize = 0;
+		valid = _read_value(file, nameSize) && nameSize < 256;
+		std::string name(valid ? nameSize : 0, '\0');
+		valid = valid && file.read(name.data(), static_cast<std::streamsize>(nameSize));
+		std::unique_ptr<Run> run;
+		if (valid && !_open_run(name, run)) {
+			std::cerr << "StateStore::readCheckpoint: Missing or unrecognised run: " << directory_ << name << "\n";
+			return false;
+		}
+		if (valid) {
+			disk_size_ += run->count;
+			checkpointed_.push_back(name);
+			runs_.push_back(std::move(run));
+		}
+	}
+	valid = valid && _read_value(file, stateSize);
+	out_search_state.assign(valid ? stateSize : 0, '\0');
+	if (!valid || !file.read(out_search_state.data(), static_cast<std::streamsize>(stateSize))) {
+		std::cerr << "StateStore::readCheckpoint: Checkpoint is incomplete: " << path << "\n";
+		return false;
+	}
+
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator(directory_, error)) {
+		const std::string name = entry.path().filename().string();
+		if (_is_run_file(entry.path()) && std::find(checkpointed_.begin(), checkpointed_.end(), name) == checkpointed_.end())
+			_remove_file(name);
+	}
+	return true;
+}
+
+bool StateStore::_in_run(const Run& run, const StateTable::Key& key) const {
+	const StateTable::Key* keys = _run_keys(run.file);
+	return std::binary_search(keys, keys + run.count, key);
+}
+
+bool StateStore::_open_run(const std::string& name, std::unique_ptr<Run>& out_run) const {
+	auto run = std::make_unique<Run>();
+	run->name = name;
+	if (!MapFile(directory_ + name, run->file) || run->file.size < sizeof(FileHeader)
+		|| !_is_header(*static_cast<const FileHeader*>(run->file.data), RUN_HEADER) || (run->file.size - sizeof(FileHeader)) % StateTable::KEY_SIZE != 0)
+		return false;
+	run->count = (run->file.size - sizeof(FileHeader)) / StateTable::KEY_SIZE;
+	// Size the filter to a power of two that holds every key at its false positive rate.
+	std::size_t filterBytes = 64;
+	while (filterBytes * filter_keys_per_byte_ < static_cast<double>(run->count))
+		filterBytes *= 2;
+	run->filter = StateFilter(filterBytes, RUN_FILTER_FALSE_POSITIVES);
+	const StateTable::Key* keys = _run_keys(run->file);
+	for (u64 i = 0; i < run->count; ++i)
+		run->filter.insert(keys[i]);
+	out_run = std::move(run);
+	return true;
+}
+
+bool StateStore::_write_run(const std::vector<StateTable::Key>& keys) {
+	const std::string name = _next_run_name();
+	std::ofstream file(directory_ + name, std::ios::binary | std::ios::trunc);
+	_write_value(file, RUN_HEADER);
+	file.write(reinterpret_cast<const char*>(keys.data()), static_cast<std::streamsize>(keys.size() * sizeof(StateTable::Key)));
+	file.close();
+	std::unique_ptr<Run> run;
+	if (!file || !_open_run(name, run)) {
+		std::cerr << "StateStore: Failed to write run: " << directory_ << name << "\n";
+		_remove_file(name);
+		return false;
+	}
+	disk_size_ += run->count;
+	runs_.push_back(std::move(run));
+	return true;
+}
+
+bool StateStore::_spill() {
+	std::vector<StateTable::Key> keys;
+	keys.reserve(hot_.size());
+	hot_.forEach([&keys](const StateTable::Key& key) { keys.push_back(key); });
+	std::sort(keys.begin(), keys.end());
+	if (!_write_run(keys))
+		return false;
+	hot_.clear();
+	return runs_.size() <= MAX_RUNS || _merge_runs();
+}
+
+bool StateStore::_merge_runs() {
+	// Keys are only ever added to one run, so the merge has no duplicates to drop.
+	const std::string name = _next_run_name();
+	std::ofstream file(directory_ + name, std::ios::binary | std::ios::trunc);
+	_write_value(file, RUN_HEADER);
+	std::vector<std::pair<const StateTable::Key*, const StateTable::Key*>> heads;
+	for (const auto& run : runs_) {
+		const StateTable::Key* keys = _run_keys(run->file);
+		heads.emplace_back(keys, keys + run->count);
+	}
+	for (;;) {
+		auto next = heads.end();
+		for (auto it = heads.begin(); it != heads.end(); ++it) {
+			if (it->first != it->second && (next == heads.end() || *it->first < *next->first))
+				next = it;
+		}
+		if (next == heads.end())
+			break;
+		file.write(reinterpret_cast<const char*>(next->first++), sizeof(StateTable::Key));
+	}
+	file.close();
+	std::unique_ptr<Run> merged;
+	if (!file || !_open_run(name, merged)) {
+		std::cerr << "StateStore: Failed to merge runs into: " << directory_ << name << "\n";
+		_remove_file(name);
+		return false;
+	}
+	for (const auto& run : runs_) {
+		UnmapFile(run->file);
+		_retire(run->name);
+	}
+	runs_.clear();
+	runs_.push_back(std::move(merged));
+	return true;
+}
+
+void StateStore::_retire(const std::string& name) {
+	if (std::find(checkpointed_.begin(), checkpointed_.end(), name) != checkpointed_.end())
+		retired_.push_back(name);
+	else
+		_remove_file(name);
+}
+
+void StateStore::_remove_file(const std::string& name) const {
+	std::error_code error;
+	std::filesystem::remove(directory_ + name, error);
+}
+
+std::string StateStore::_next_run_name() {
+	return RUN_PREFIX + std::to_string(next_run_id_++) + RUN_EXTENSION;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "units.hpp"
+#include "Platform.hpp"
+#include "StateFilter.hpp"
+#include "StateTable.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace solitaire {
+	// Set of seen game states for searches too big for memory. New states go in an in-memory StateTable. When it fills, its keys are
+	// sorted and written out as a run file, and the table is emptied. Runs are memory mapped and binary searched, each behind a
+	// StateFilter, so looking up a new state rarely touches them. Once there are too many runs, they're merged into one.
+	// A checkpoint writes the table out, and records the runs holding every state seen so far, so a search can be resumed after a restart.
+	// Only one store should use a directory at a time.
+	class StateStore {
+	public:
+		StateStore() = default;
+		StateStore(const StateStore&) = delete;
+		StateStore& operator=(const StateStore&) = delete;
+		~StateStore();
+
+		// Open a store directory, creating it if need be. The table is kept to half the memory budget, leaving the rest for the
+		// runs' filters (about 2 bytes per state on disk).
+		// Runs already in the directory are left for readCheckpoint (or clear). Returns false if there is an error.
+		bool open(const std::string& directory, std::size_t memoryBytes);
+		// Returns true if the key was not already in the store. Throws std::runtime_error if a run can't be written.
+		bool insert(const StateTable::Key& key);
+		// Remove all states, and their run files.
+		void clear();
+
+		// Write the table out as a run, then a checkpoint file listing the runs, along with the caller's search state.
+		// Runs only the previous checkpoint needed are removed once it's replaced. Returns false if there is an error.
+		bool writeCheckpoint(const std::string& path, const std::string& searchState);
+		// Reopen the runs a checkpoint lists, and read back its search state. Runs written after the checkpoint are removed,
+		// as the states in them were seen by the part of the search that is being redone. Returns false if there is an error.
+		bool readCheckpoint(const std::string& path, std::string& out_search_state);
+
+		u64 size() const { return hot_.size() + disk_size_; }
+		u64 diskSize() const { return disk_size_; }
+		std::size_t numRuns() const { return runs_.size(); }
+
+	private:
+		struct Run {
+			~Run();
+			std::string name;
+			MappedFile file;
+			u64 count{ 0 };
+			StateFilter filter;
+		};
+
+		static constexpr std::size_t MAX_RUNS = 8;
+		static constexpr double RUN_FILTER_FALSE_POSITIVES = 0.01;
+
+		bool _in_run(const Run& run, const StateTable::Key& key) const;
+		// Map a run file, and build its filter. Returns false if it's missing or unrecognised.
+		bool _open_run(const std::string& name, std::unique_ptr<Run>& out_run) const;
+		// Write sorted keys out as a new run.
+		bool _write_run(const std::vector<StateTable::Key>& keys);
+		bool _spill();
+		bool _merge_runs();
+		// Remove a run file, unless the last checkpoint needs it.
+		void _retire(const std::string& name);
+		void _remove_file(const std::string& name) const;
+		std::string _next_run_name();
+
+		std::string directory_;
+		StateTable hot_;
+		std::size_t hot_limit_ = 0; // Keys the table takes before it's spilled, so it never grows past its share of the budget.
+		double filter_keys_per_byte_ = 0; // Keys a run's filter holds per byte of memory.
+		std::vector<std::unique_ptr<Run>> runs_;
+		u64 disk_size_ = 0;
+		u64 next_run_id_ = 0;
+		std::vector<std::string> checkpointed_; // Runs the last checkpoint lists.
+		std::vector<std::string> retired_;      // Runs that were merged away, but the last checkpoint still needs.
+	};
+}
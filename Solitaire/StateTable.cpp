@@ -0,0 +1,131 @@
+#include "StateTable.hpp"
+
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <utility>
+
+using namespace solitaire;
+
+namespace {
+	std::uint32_t _hash_key(const StateTable::Key& key) {
+		std::uint64_t h = 0;
+		for (std::size_t i = 0; i < StateTable::KEY_SIZE; i += sizeof(std::uint64_t)) {
+			std::uint64_t word;
+			std::memcpy(&word, key.data() + i, sizeof(word));
+			h = (h ^ word) * 0x9E3779B97F4A7C15ull;
+			h ^= h >> 29;
+		}
+		return static_cast<std::uint32_t>(h ^ (h >> 32));
+	}
+}
+
+StateTable::StateTable(StateTable&& o) noexcept
+	: memory_(std::exchange(o.memory_, {})), slots_(std::exchange(o.slots_, nullptr)), mask_(std::exchange(o.mask_, 0)), size_(std::exchange(o.size_, 0)), generation_(std::exchange(o.generation_, 1)) {}
+
+StateTable& StateTable::operator=(const StateTable& o) noexcept {
+	if (this != &o)
+		release();
+	return *this;
+}
+
+StateTable& StateTable::operator=(StateTable&& o) noexcept {
+	if (this != &o) {
+		release();
+		memory_ = std::exchange(o.memory_, {});
+		slots_ = std::exchange(o.slots_, nullptr);
+		mask_ = std::exchange(o.mask_, 0);
+		size_ = std::exchange(o.size_, 0);
+		generation_ = std::exchange(o.generation_, 1);
+	}
+	return *this;
+}
+
+StateTable::~StateTable() {
+	release();
+}
+
+bool StateTable::insert(const Key& key) {
+	// Keep the load factor under 60%, as linear probing slows down quickly past that.
+	if ((size_ + 1) * 5 > (mask_ + 1) * 3 && !_grow())
+		throw std::bad_alloc();
+
+	const std::uint32_t hash = _hash_key(key);
+	for (std::size_t i = hash & mask_; ; i = (i + 1) & mask_) {
+		Slot& slot = slots_[i];
+		if (slot.generation != generation_) {
+			slot.key = key;
+			slot.hash = hash;
+			slot.generation = generation_;
+			++size_;
+			return true;
+		}
+		if (slot.hash == hash && slot.key == key)
+			return false;
+	}
+}
+
+bool StateTable::contains(const Key& key) const {
+	if (size_ == 0)
+		return false;
+	const std::uint32_t hash = _hash_key(key);
+	for (std::size_t i = hash & mask_; ; i = (i + 1) & mask_) {
+		const Slot& slot = slots_[i];
+		if (slot.generation != generation_)
+			return false;
+		if (slot.hash == hash && slot.key == key)
+			return true;
+	}
+}
+
+void StateTable::clear() {
+	size_ = 0;
+	if (++generation_ == 0) {
+		// Wrapped around, so old stamps could look current. Start again from zeroed slots.
+		if (slots_)
+			std::memset(static_cast<void*>(slots_), 0, (mask_ + 1) * sizeof(Slot));
+		generation_ = 1;
+	}
+}
+
+void StateTable::release() {
+	FreePages(memory_);
+	slots_ = nullptr;
+	mask_ = 0;
+	size_ = 0;
+}
+
+bool StateTable::_allocate(std::size_t capacity) {
+	memory_ = AllocatePages(capacity * sizeof(Slot));
+	if (!memory_.data) {
+		std::cerr << "StateTable: Failed to allocate memory for " << capacity << " states.\n";
+		return false;
+	}
+	// Pages come zeroed, so every slot starts out unused.
+	slots_ = static_cast<Slot*>(memory_.data);
+	mask_ = capacity - 1;
+	return true;
+}
+
+bool StateTable::_grow() {
+	if (!slots_)
+		return _allocate(INITIAL_CAPACITY);
+
+	PageAllocation oldMemory = std::exchange(memory_, {});
+	const Slot* oldSlots = slots_;
+	const std::size_t oldCapacity = mask_ + 1;
+	if (!_allocate(oldCapacity * 2)) {
+		memory_ = oldMemory;
+		return false;
+	}
+	for (std::size_t i = 0; i < oldCapacity; ++i) {
+		if (oldSlots[i].generation != generation_)
+			continue;
+		std::size_t j = oldSlots[i].hash & mask_;
+		while (slots_[j].generation == generation_)
+			j = (j + 1) & mask_;
+		slots_[j] = oldSlots[i];
+	}
+	FreePages(oldMemory);
+	return true;
+}
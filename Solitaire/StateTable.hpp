@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Platform.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace solitaire {
+	// Set of game states the solver has seen. Keys are fixed size and stored inline, one cache line per slot,
+	// with open addressing (linear probing) over memory from AllocatePages.
+	// Slots are stamped with the generation they were written in, so clearing the table is just starting a new generation.
+	// The memory is kept until released, so a solver reuses the same table for every seed.
+	class StateTable {
+	public:
+		static constexpr std::size_t KEY_SIZE = 56;
+		using Key = std::array<std::uint8_t, KEY_SIZE>;
+		static constexpr std::size_t SLOT_SIZE = 64; // Bytes of memory per slot.
+
+		StateTable() = default;
+		// Copies start out empty. Memory is only allocated on first insert, so that it is local to the thread using the table.
+		StateTable(const StateTable&) noexcept {}
+		StateTable(StateTable&& o) noexcept;
+		StateTable& operator=(const StateTable& o) noexcept;
+		StateTable& operator=(StateTable&& o) noexcept;
+		~StateTable();
+
+		// Returns true if the key was not already in the table.
+		bool insert(const Key& key);
+		bool contains(const Key& key) const;
+		// Call f with each key in the table, in no particular order.
+		template <typename F>
+		void forEach(F&& f) const {
+			for (std::size_t i = 0; slots_ && i <= mask_; ++i) {
+				if (slots_[i].generation == generation_)
+					f(slots_[i].key);
+			}
+		}
+		// Remove all keys, keeping the memory.
+		void clear();
+		// Remove all keys, and free the memory.
+		void release();
+
+		std::size_t size() const { return size_; }
+		std::size_t capacity() const { return slots_ ? mask_ + 1 : 0; }
+		PageKind getPageKind() const { return memory_.kind; }
+
+	private:
+		struct alignas(64) Slot {
+			Key key;
+			std::uint32_t hash;
+			std::uint32_t generation; // Slots from other generations are empty.
+		};
+		static_assert(sizeof(Slot) == SLOT_SIZE, "Slots should fill a cache line.");
+
+		static constexpr std::size_t INITIAL_CAPACITY = 1 << 14; // Slots. Must be a power of two.
+
+		// Returns false if the memory couldn't be allocated.
+		bool _allocate(std::size_t capacity);
+		bool _grow();
+
+		PageAllocation memory_;
+		Slot* slots_ = nullptr;
+		std::size_t mask_ = 0; // Capacity - 1.
+		std::size_t size_ = 0;
+		std::uint32_t generation_ = 1; // Never 0, so that zeroed memory is empty.
+	};
+}
@@ -0,0 +1,99 @@
+#include "TableauMatch.hpp"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define SOLITAIRE_X86
+#include <immintrin.h>
+#endif
+
+#include <cstring>
+
+using namespace solitaire;
+
+namespace {
+	using MatchKernel = void (*)(TableauTargets targets, const u8* keys, std::size_t count, PileMask* out_masks);
+
+	void _match_scalar(TableauTargets targets, const u8* keys, std::size_t count, PileMask* out_masks) {
+		for (std::size_t i = 0; i < count; ++i)
+			out_masks[i] = MatchTableauTargets(targets, keys[i]);
+	}
+
+#ifdef SOLITAIRE_X86
+	// Both kernels compare the targets against one key per 8 byte lane, then take the byte-wise result as a bitmask.
+
+	// SSE2 is part of x86-64, so this needs no runtime check there.
+	void _match_sse2(TableauTargets targets, const u8* keys, std::size_t count, PileMask* out_masks) {
+		const __m128i targetLanes = _mm_set1_epi64x(static_cast<long long>(targets));
+		std::size_t i = 0;
+		for (; i + 2 <= count; i += 2) {
+			const __m128i keyLanes = _mm_unpacklo_epi64(_mm_set1_epi8(static_cast<char>(keys[i])), _mm_set1_epi8(static_cast<char>(keys[i + 1])));
+			const u32 matches = static_cast<u32>(_mm_movemask_epi8(_mm_cmpeq_epi8(targetLanes, keyLanes)));
+			out_masks[i] = static_cast<PileMask>(matches);
+			out_masks[i + 1] = static_cast<PileMask>(matches >> 8);
+		}
+		_match_scalar(targets, keys + i, count - i, out_masks + i);
+	}
+
+#if defined(__GNUC__) || defined(__clang__)
+	__attribute__((target("avx2")))
+#endif
+	void _match_avx2(TableauTargets targets, const u8* keys, std::size_t count, PileMask* out_masks) {
+		const __m256i targetLanes = _mm256_set1_epi64x(static_cast<long long>(targets));
+		// Spreads 4 keys (one per byte) so each fills its own 8 byte lane.
+		const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+		std::size_t i = 0;
+		for (; i + 4 <= count; i += 4) {
+			u32 packedKeys;
+			std::memcpy(&packedKeys, keys + i, sizeof(packedKeys));
+			const __m256i keyLanes = _mm256_shuffle_epi8(_mm256_set1_epi32(static_cast<int>(packedKeys)), spread);
+			const u32 matches = static_cast<u32>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(targetLanes, keyLanes)));
+			std::memcpy(out_masks + i, &matches, sizeof(matches));
+		}
+		_match_sse2(targets, keys + i, count - i, out_masks + i);
+	}
+
+	bool _has_avx2() {
+#if defined(__GNUC__) || defined(__clang__)
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+		__cpuid(info, 1);
+		const bool osSavesAvx = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6; // OSXSAVE, and the OS saves the YMM registers.
+		__cpuidex(info, 7, 0);
+		return osSavesAvx && (info[1] & (1 << 5)) != 0;
+#else
+		return false;
+#endif
+	}
+#endif
+
+	struct KernelChoice {
+		MatchKernel kernel;
+		const char* name;
+	};
+
+	const KernelChoice& _kernel() {
+		static const KernelChoice choice = [] {
+#ifdef SOLITAIRE_X86
+			if (_has_avx2())
+				return KernelChoice{ _match_avx2, "AVX2" };
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+			return KernelChoice{ _match_sse2, "SSE2" };
+#endif
+#endif
+			return KernelChoice{ _match_scalar, "scalar" };
+		}();
+		return choice;
+	}
+}
+
+void solitaire::MatchTableauTargets(TableauTargets targets, const u8* keys, std::size_t count, PileMask* out_masks) {
+	_kernel().kernel(targets, keys, count, out_masks);
+}
+
+const char* solitaire::TableauMatchKernel() {
+	return _kernel().name;
+}
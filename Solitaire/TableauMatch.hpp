@@ -0,0 +1,62 @@
+#pragma once
+
+#include "units.hpp"
+#include "Card.hpp"
+
+#include <cstddef>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Matching cards against every tableau pile at once, for move generation.
+// Each pile gets a byte holding the key of the card it accepts, packed into one word, so matching a card is a single
+// byte-wise compare. Batches of cards are matched with SSE2 or AVX2 where the CPU supports it (chosen at runtime).
+
+namespace solitaire {
+	// One byte per tableau pile (the 8th is padding, and never matches).
+	using TableauTargets = u64;
+	// Bit i is set if the card can be placed on tableau pile i.
+	using PileMask = u8;
+
+	// Key of a card, for matching: rank and colour. Kings only go to empty piles, so they all get the empty pile's key.
+	inline u8 TableauKey(const Card& c) {
+		return c.getRank() == RANK_KING ? 0xFF : static_cast<u8>(c.getRank() << 1 | (IsRed(c.getSuit()) ? 1 : 0));
+	}
+	// Key accepted by an empty pile.
+	constexpr u8 EMPTY_PILE_TARGET = 0xFF;
+	// Key accepted by a pile with this card on top: one rank lower, opposite colour. An ace accepts nothing (no key is below 2).
+	inline u8 TableauTarget(const Card& top) {
+		return static_cast<u8>((top.getRank() - 1) << 1 | (IsRed(top.getSuit()) ? 0 : 1));
+	}
+	inline TableauTargets SetTableauTarget(TableauTargets targets, u8 pile, u8 target) {
+		return (targets & ~(TableauTargets{ 0xFF } << (pile * 8))) | (TableauTargets{ target } << (pile * 8));
+	}
+
+	// Piles a card with the given key can be placed on.
+	inline PileMask MatchTableauTargets(TableauTargets targets, u8 key) {
+		constexpr u64 LOW_BITS = 0x0101010101010101ull;
+		constexpr u64 HIGH_BITS = 0x7F7F7F7F7F7F7F7Full;
+		// Zero the bytes that match, then set the top bit of only those bytes (without carries between bytes).
+		const u64 diff = targets ^ (key * LOW_BITS);
+		const u64 zeroBytes = ~(((diff & HIGH_BITS) + HIGH_BITS) | diff | HIGH_BITS);
+		// Gather the top bit of each byte into the low byte.
+		return static_cast<PileMask>(((zeroBytes >> 7) * 0x0102040810204080ull) >> 56);
+	}
+
+	// Match a batch of keys, writing a pile mask for each.
+	void MatchTableauTargets(TableauTargets targets, const u8* keys, std::size_t count, PileMask* out_masks);
+	// Which kernel the batch matching uses ("AVX2", "SSE2" or "scalar").
+	const char* TableauMatchKernel();
+
+	// Index of the lowest pile in a non-empty mask.
+	inline u8 LowestPile(PileMask mask) {
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return static_cast<u8>(index);
+#else
+		return static_cast<u8>(__builtin_ctz(mask));
+#endif
+	}
+}
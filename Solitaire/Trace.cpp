@@ -0,0 +1,97 @@
+#include "Trace.hpp"
+
+#include <fstream>
+#include <iostream>
+
+using namespace solitaire;
+
+namespace {
+	u64 _since(TraceRecorder::Clock::time_point start, TraceRecorder::Clock::time_point time) {
+		return time < start ? 0 : static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(time - start).count());
+	}
+
+	// Trace times are in microseconds, with nanoseconds kept as decimals.
+	void _write_micros(std::ostream& output, u64 nanoseconds) {
+		const u64 fraction = nanoseconds % 1000;
+		output << nanoseconds / 1000 << "." << fraction / 100 << fraction / 10 % 10 << fraction % 10;
+	}
+
+	void _write_escaped(std::ostream& output, const std::string& str) {
+		for (char c : str) {
+			if (c == '"' || c == '\\')
+				output << '\\';
+			output << c;
+		}
+	}
+}
+
+TraceRecorder::TraceRecorder() : id_([] { static std::atomic<u64> next{ 1 }; return next++; }()), start_(Clock::now()) {}
+
+void TraceRecorder::setThreadName(std::string name) {
+	ThreadBuffer& buffer = _thread_buffer();
+	std::lock_guard<std::mutex> lock(threads_mutex_);
+	buffer.name = std::move(name);
+}
+
+void TraceRecorder::record(const char* name, Clock::time_point start, Clock::time_point end, const char* argName, u64 arg) {
+	ThreadBuffer& buffer = _thread_buffer();
+	const u64 startTime = _since(start_, start);
+	Event event{ name, startTime, _since(start_, end) - startTime, argName, arg };
+	if (buffer.events.size() < BUFFER_EVENTS)
+		buffer.events.push_back(event);
+	else
+		buffer.events[buffer.written % BUFFER_EVENTS] = event;
+	++buffer.written;
+}
+
+TraceRecorder::ThreadBuffer& TraceRecorder::_thread_buffer() {
+	// Cache the calling thread's buffer. The recorder's id is checked, in case a thread outlives one recorder and records to another.
+	thread_local u64 owner = 0;
+	thread_local ThreadBuffer* buffer = nullptr;
+	if (owner != id_) {
+		std::lock_guard<std::mutex> lock(threads_mutex_);
+		auto& newBuffer = threads_.emplace_back(std::make_unique<ThreadBuffer>());
+		newBuffer->id = static_cast<u32>(threads_.size());
+		newBuffer->name = "thread " + std::to_string(newBuffer->id);
+		newBuffer->events.reserve(1024);
+		owner = id_;
+		buffer = newBuffer.get();
+	}
+	return *buffer;
+}
+
+bool TraceRecorder::exportJson(const std::string& path) const {
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open()) {
+		std::cerr << "TraceRecorder::exportJson: Failed to open trace file: " << path << "\n";
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(threads_mutex_);
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	bool first = true;
+	u64 dropped = 0;
+	for (const auto& thread : threads_) {
+		file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread->id << ",\"args\":{\"name\":\"";
+		_write_escaped(file, thread->name);
+		file << "\"}}";
+		first = false;
+		// Write oldest first, starting after the newest event if the ring wrapped.
+		const std::size_t count = thread->events.size();
+		const std::size_t oldest = thread->written > count ? thread->written % count : 0;
+		dropped += thread->written - count;
+		for (std::size_t i = 0; i < count; ++i) {
+			const Event& event = thread->events[(oldest + i) % count];
+			file << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread->id << ",\"ts\":";
+			_write_micros(file, event.start);
+			file << ",\"dur\":";
+			_write_micros(file, event.duration);
+			if (event.argName)
+				file << ",\"args\":{\"" << event.argName << "\":" << event.arg << "}";
+			file << "}";
+		}
+	}
+	file << "\n]}\n";
+	if (dropped > 0)
+		std::cout << "Trace buffers wrapped, dropping the oldest " << dropped << " events.\n";
+	return static_cast<bool>(file);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "units.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Timeline recorder for batch runs, exported as Chrome trace event JSON (viewable in chrome://tracing or Perfetto).
+// Each thread records into its own ring buffer, so recording takes no locks. When a buffer is full, its oldest events are overwritten.
+// Buffers are only read by the export, which must run once the recording threads are idle.
+
+namespace solitaire {
+	class TraceRecorder {
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		// Events kept per thread.
+		static constexpr std::size_t BUFFER_EVENTS = 1 << 16;
+
+		TraceRecorder();
+		TraceRecorder(const TraceRecorder&) = delete;
+		TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+		// Events are only recorded while recording is on, so it can be switched on just for sampled batches.
+		bool isRecording() const { return recording_.load(std::memory_order_relaxed); }
+		void setRecording(bool recording) { recording_.store(recording, std::memory_order_relaxed); }
+
+		// Name the calling thread in the trace.
+		void setThreadName(std::string name);
+		// Record an event that ran from start to end, with an optional argument. Names must outlive the recorder (EG string literals).
+		void record(const char* name, Clock::time_point start, Clock::time_point end, const char* argName = nullptr, u64 arg = 0);
+
+		// Returns false if the file can't be written.
+		bool exportJson(const std::string& path) const;
+
+	private:
+		struct Event {
+			const char* name;
+			u64 start; // Nanoseconds since the recorder was created.
+			u64 duration;
+			const char* argName;
+			u64 arg;
+		};
+		struct ThreadBuffer {
+			u32 id;
+			std::string name;
+			std::vector<Event> events;
+			u64 written{ 0 }; // Total events recorded. The buffer holds the last BUFFER_EVENTS of them.
+		};
+
+		ThreadBuffer& _thread_buffer();
+
+		const u64 id_; // Unique per recorder, to find each thread's buffer.
+		const Clock::time_point start_;
+		std::atomic<bool> recording_{ false };
+		mutable std::mutex threads_mutex_; // Only taken the first time a thread records, and to export.
+		std::vector<std::unique_ptr<ThreadBuffer>> threads_;
+	};
+
+	// Records the time until it goes out of scope as an event. Does nothing if the recorder is null or not recording.
+	class TraceScope {
+	public:
+		TraceScope(TraceRecorder* recorder, const char* name, const char* argName = nullptr, u64 arg = 0)
+			: recorder_(recorder && recorder->isRecording() ? recorder : nullptr), name_(name), arg_name_(argName), arg_(arg) {
+			if (recorder_)
+				start_ = TraceRecorder::Clock::now();
+		}
+		~TraceScope() {
+			if (recorder_)
+				recorder_->record(name_, start_, TraceRecorder::Clock::now(), arg_name_, arg_);
+		}
+		TraceScope(const TraceScope&) = delete;
+		TraceScope& operator=(const TraceScope&) = delete;
+
+	private:
+		TraceRecorder* recorder_;
+		const char* name_;
+		const char* arg_name_;
+		u64 arg_;
+		TraceRecorder::Clock::time_point start_;
+	};
+}
@@ -1,17 +1,28 @@
 #include "batchrunner.hpp"
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <iomanip>
 #include <iostream>
 #include <fstream>
+#include <limits>
+#include <memory>
 #include <numeric>
 #include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "KlondikeSolver.hpp"
+#include "MovePriorities.hpp"
+#include "Platform.hpp"
+#include "ResultCache.hpp"
+#include "ResultsMerge.hpp"
+#include "SolutionArchive.hpp"
+#include "Sharding.hpp"
+#include "Trace.hpp"
 #include "threadpool/threadpool/Threadpool.hpp"
 
 #ifdef _WIN32
@@ -26,22 +37,29 @@ using Clock = std::chrono::high_resolution_clock;
 using namespace solitaire;
 
 namespace {
-	constexpr std::string_view SOLUTIONS_SUBFOLDER = "/solutions/";
-
 	struct Stats {
 		u64 startSeed{ 0 };
 		u64 endSeed{ 0 };
 		u64 totalGames{ 0 };
 		u64 wins{ 0 };
 		u64 losses{ 0 };
+		u64 probableLosses{ 0 }; // Losses found with an approximate state filter, which aren't proofs.
 		u64 unknown{ 0 };
+		u64 totalPositions{ 0 }; // Positions tried over all games solved in this run, including unsolved ones.
+		u64 cacheLookups{ 0 };
+		u64 cacheHits{ 0 };      // Games whose result came from the result cache.
 		float completedGamesAveragePositionsTried{ 0 };
 		float wonGamesAveragePositionsTried{ 0 };
 		float lostGamesAveragePositionsTried{ 0 };
 		float averageSolutionDepth{ 0 };
 		u64 maxSolutionDepth{ 0 };
 		u64 minSolutionDepth{ std::numeric_limits<u64>::max() };
+		AutoMoveCounts autoMoves{};
+		EndgameCounts endgame{};
+		u64 sleepingMovesSkipped{ 0 };
 		std::chrono::seconds runTime{ 0 };
+		float positionsPerSecond{ 0 };
+		u32 mergedDirectories{ 0 }; // If the stats are for merged results, there's no timing or auto-move info.
 	};
 
 	constexpr u64 _unsigned_ceil(float f) noexcept {
@@ -69,12 +87,8 @@ namespace {
 			std::cerr << "Failed to create results directory.\n";
 			return false;
 		}
-		if (::_mkdir((resultsDir + std::string(SOLUTIONS_SUBFOLDER)).c_str()) != 0 && errno != EEXIST) {
-			std::cerr << "Failed to create solutions directory.\n";
-			return false;
-		}
 #else
-		if (std::string cmd = "mkdir -p " + resultsDir + std::string(SOLUTIONS_SUBFOLDER); system(cmd.c_str()) == -1) {
+		if (std::string cmd = "mkdir -p " + resultsDir; system(cmd.c_str()) == -1) {
 			std::cerr << "Failed to create output directory.\n";
 			return false;
 		}
@@ -82,106 +96,210 @@ namespace {
 		return true;
 	}
 
-	void _write_solution_file(std::string_view resultsDir, const GameResult& result) {
-		std::stringstream fileName;
-		fileName << resultsDir << SOLUTIONS_SUBFOLDER << PadWrite(result.seed) << ".txt";
-		std::ofstream solutionFile(fileName.str(), std::ios::trunc);
-
-		// Print off moves list.
-		for (const Move& move : result.solution) {
-			solutionFile << MoveToStr(move) << " ";
+	// Write out the moves of a solution, and the board after each one. Returns false if a move is illegal.
+	template <typename Rules>
+	bool _render_solution(std::ostream& output, u64 seed, const MoveList& solution) {
+		for (const Move& move : solution) {
+			output << MoveToStr(move) << " ";
 		}
-		solutionFile << "\n\n";
+		output << "\n\n";
 
-		KlondikeGame game(result.seed);
+		KlondikeGame<Rules> game(seed);
 		game.setUpGame();
 
-		game.printGame(solutionFile);
+		game.printGame(output);
 
-		for (const Move& move : result.solution) {
-			KlondikeSolver::doMove(game, move);
-			game.printGame(solutionFile);
-			solutionFile << MoveToStr(move) << "\n";
+		for (const Move& move : solution) {
+			if (!KlondikeSolver<Rules>::tryDoMove(game, move)) {
+				std::cerr << "Illegal move in solution for seed " << seed << ": " << MoveToStr(move) << "\n";
+				return false;
+			}
+			game.printGame(output);
+			output << MoveToStr(move) << "\n";
 		}
+		return true;
 	}
 
-	void _write_stats(const std::string& resultsDir, const Stats& stats) {
-		std::ofstream statsFile(resultsDir + "stats.txt", std::ios::app);
+	void _write_stats(const std::string& resultsDir, const Stats& stats, std::ios::openmode mode = std::ios::app) {
+		std::ofstream statsFile(resultsDir + "stats.txt", mode);
 		statsFile << "Ran from seed    " << PadWrite(stats.startSeed) << " to seed " << PadWrite(stats.endSeed) << "\n";
 		statsFile << "Total games run: " << PadWrite(stats.totalGames) << "\n";
 		statsFile << "Wins:            " << PadWrite(stats.wins) << " (" << PadWrite(stats.wins / static_cast<float>(stats.totalGames) * 100, ' ', 2) << "%)\n";
 		statsFile << "Losses:          " << PadWrite(stats.losses) << " (" << PadWrite(stats.losses / static_cast<float>(stats.totalGames) * 100, ' ', 2) << "%)\n";
+		if (stats.probableLosses > 0)
+			statsFile << "  Probable only: " << PadWrite(stats.probableLosses) << " (found with the approximate state filter)\n";
 		statsFile << "Unsolved:        " << PadWrite(stats.unknown) << " (" << PadWrite(stats.unknown / static_cast<float>(stats.totalGames) * 100, ' ', 2) << "%)\n";
+		if (stats.cacheLookups > 0)
+			statsFile << "Cache hits:      " << PadWrite(stats.cacheHits) << " (" << PadWrite(stats.cacheHits / static_cast<float>(stats.cacheLookups) * 100, ' ', 2) << "%)\n";
 		statsFile << "Solved games:    " << PadWrite((stats.wins + stats.losses) / static_cast<float>(stats.totalGames) * 100, ' ', 2) << "%\n";
 		statsFile << "Average positions tried for wins:            " << PadWrite(stats.wonGamesAveragePositionsTried) << "\n";
 		statsFile << "Average positions tried for losses:          " << PadWrite(stats.lostGamesAveragePositionsTried) << "\n";
 		statsFile << "Average positions tried for completed games: " << PadWrite(stats.completedGamesAveragePositionsTried) << "\n";
 		statsFile << "Average solution depth: " << PadWrite(stats.averageSolutionDepth)
 			<< " (min: " << PadWrite(stats.minSolutionDepth, ' ', 3) << ", max: " << PadWrite(stats.maxSolutionDepth, ' ', 3) << ")\n";
+		if (stats.mergedDirectories > 0) {
+			statsFile << "Merged from " << stats.mergedDirectories << " result directories.\n";
+			statsFile << "********\n\n";
+			return;
+		}
+		for (u8 i = 0; i < NUM_AUTO_MOVE_RULES; ++i) {
+			statsFile << "Auto-moves (" << std::setw(14) << std::left << AutoMoveRuleToStr(static_cast<AutoMoveRule>(i)) << std::right << "): " << PadWrite(stats.autoMoves[i])
+				<< " (average per game: " << PadWrite(stats.autoMoves[i] / static_cast<float>(stats.totalGames), ' ', 2) << ")\n";
+		}
+		statsFile << "Endgame play-outs: " << PadWrite(stats.endgame.playOuts) << " of " << stats.endgame.attempts << " tried"
+			<< " (average moves per play-out: " << PadWrite(stats.endgame.playOuts == 0 ? 0.f : stats.endgame.moves / static_cast<float>(stats.endgame.playOuts), ' ', 2) << ")\n";
+		statsFile << "Sleeping moves skipped: " << PadWrite(stats.sleepingMovesSkipped) << "\n";
 		statsFile << "Total run time: " << PadWrite(stats.runTime.count()) << "s\n";
+		statsFile << "Positions per second: " << PadWrite(stats.positionsPerSecond, ' ', 12, 0) << "\n";
 
 		statsFile << "********\n\n";
 	}
 
-	void _write_results(const std::vector<GameResult>& results, const std::string& resultsDir, bool writeSolutions) {
+	SeedOutcome _to_outcome(GameResult::Result result) {
+		constexpr SeedOutcome OUTCOMES[] = { SeedOutcome::WIN, SeedOutcome::LOSE, SeedOutcome::UNKNOWN };
+		return OUTCOMES[toUType(result)];
+	}
+
+	GameResult::Result _to_result(SeedOutcome outcome) {
+		constexpr GameResult::Result RESULTS[] = { GameResult::Result::WIN, GameResult::Result::LOSE, GameResult::Result::UNKNOWN };
+		return RESULTS[toUType(outcome)];
+	}
+
+	// Identifies the ruleset and solver version of a cached result.
+	template <typename Rules>
+	constexpr u32 _cache_config_key() {
+		return SOLVER_VERSION << 24 | u32{ Rules::NUM_STOCK_CARD_DRAW } << 16 | u32{ Rules::REDEAL_LIMIT } << 8 | (Rules::FOUNDATION_TO_TABLEAU ? 1u : 0u);
+	}
+
+	CachedResult _to_cached(const GameResult& result, u32 configKey, u64 maxStates) {
+		CachedResult cached;
+		cached.seed = result.seed;
+		cached.positionsTried = result.positionsTried;
+		cached.maxStates = maxStates;
+		cached.configKey = configKey;
+		cached.solutionLength = static_cast<std::uint16_t>(std::min<size_t>(result.solution.size(), std::numeric_limits<std::uint16_t>::max()));
+		cached.outcome = _to_outcome(result.result);
+		return cached;
+	}
+
+	// Results and cached results are both sorted by seed, and are written out merged.
+	void _write_results(const std::vector<GameResult>& results, const std::vector<CachedResult>& cachedResults, const std::string& resultsDir, bool writeSolutions) {
 		std::ofstream winFile(resultsDir + "winning_seeds.txt", std::ios::app);
 		std::ofstream loseFile(resultsDir + "losing_seeds.txt", std::ios::app);
 		std::ofstream unknownFile(resultsDir + "unknown_seeds.txt", std::ios::app);
+		std::ofstream probableLoseFile;
+		std::ofstream solutionsArchive;
+		if (writeSolutions)
+			solutionsArchive.open(resultsDir + std::string(SOLUTIONS_ARCHIVE_FILE), std::ios::app);
 
-		for (const GameResult& result : results) {
-			switch (result.result) {
+		auto writeLine = [&](GameResult::Result result, u64 seed, u64 positionsTried, u64 solutionLength) {
+			switch (result) {
 			case(GameResult::Result::WIN):
-				winFile << PadWrite(result.seed, '0') << " (positions tried: " << PadWrite(result.positionsTried) << ", solution length: " << PadWrite(result.solution.size()) << ")\n";
-				if (writeSolutions)
-					_write_solution_file(resultsDir, result);
+				winFile << PadWrite(seed, '0') << " (positions tried: " << PadWrite(positionsTried) << ", solution length: " << PadWrite(solutionLength) << ")\n";
 				break;
 			case(GameResult::Result::LOSE):
-				loseFile << PadWrite(result.seed, '0') << " (positions tried: " << PadWrite(result.positionsTried) << ")\n";
+				loseFile << PadWrite(seed, '0') << " (positions tried: " << PadWrite(positionsTried) << ")\n";
 				break;
 			case(GameResult::Result::UNKNOWN):
-				unknownFile << PadWrite(result.seed, '0') << " (positions tried: " << PadWrite(result.positionsTried) << ")\n";
+				unknownFile << PadWrite(seed, '0') << " (positions tried: " << PadWrite(positionsTried) << ")\n";
 				break;
 			}
+		};
+		auto cachedIt = cachedResults.begin();
+		auto writeCachedBefore = [&](u64 seed) {
+			for (; cachedIt != cachedResults.end() && cachedIt->seed < seed; ++cachedIt)
+				writeLine(_to_result(cachedIt->outcome), cachedIt->seed, cachedIt->positionsTried, cachedIt->solutionLength);
+		};
+		for (const GameResult& result : results) {
+			writeCachedBefore(result.seed);
+			if (result.approximate && result.result == GameResult::Result::LOSE) {
+				// Kept out of the losing seeds, so they aren't merged or reused as proven losses.
+				if (!probableLoseFile.is_open())
+					probableLoseFile.open(resultsDir + "probable_losing_seeds.txt", std::ios::app);
+				probableLoseFile << PadWrite(result.seed, '0') << " (positions tried: " << PadWrite(result.positionsTried) << ")\n";
+				continue;
+			}
+			writeLine(result.result, result.seed, result.positionsTried, result.solution.size());
+			if (writeSolutions && result.result == GameResult::Result::WIN)
+				WriteSolution(solutionsArchive, result.seed, result.solution);
 		}
+		for (; cachedIt != cachedResults.end(); ++cachedIt)
+			writeLine(_to_result(cachedIt->outcome), cachedIt->seed, cachedIt->positionsTried, cachedIt->solutionLength);
 	}
 
-	void _update_stats(const std::vector<GameResult>& results, Stats& stats) {
+	// Running totals for a set of results, to fold into the stats.
+	struct ResultTotals {
 		u64 wins{ 0 }, losses{ 0 }, unknown{ 0 };
-		u64 winPositions{ 0 }, lossPositions{ 0 };
+		u64 winPositions{ 0 }, lossPositions{ 0 }, allPositions{ 0 };
 		u64 solutionLengths{ 0 };
-		for (const auto& r : results) {
-			switch (r.result) {
+		u64 minSolutionDepth{ std::numeric_limits<u64>::max() }, maxSolutionDepth{ 0 };
+
+		void add(GameResult::Result result, u64 positionsTried, u64 solutionLength) {
+			allPositions += positionsTried;
+			switch (result) {
 			case(GameResult::Result::WIN):
 				++wins;
-				winPositions += r.positionsTried;
-				solutionLengths += r.solution.size();
-				if (r.solution.size() > stats.maxSolutionDepth)
-					stats.maxSolutionDepth = r.solution.size();
-				if (r.solution.size() < stats.minSolutionDepth)
-					stats.minSolutionDepth = r.solution.size();
+				winPositions += positionsTried;
+				solutionLengths += solutionLength;
+				maxSolutionDepth = std::max(maxSolutionDepth, solutionLength);
+				minSolutionDepth = std::min(minSolutionDepth, solutionLength);
 				break;
 			case(GameResult::Result::LOSE):
 				++losses;
-				lossPositions += r.positionsTried;
+				lossPositions += positionsTried;
 				break;
 			case(GameResult::Result::UNKNOWN):
 				++unknown;
 				break;
 			}
 		}
-		const auto allWins = stats.wins + wins;
-		stats.wonGamesAveragePositionsTried = allWins == 0 ? 0 : (stats.wonGamesAveragePositionsTried * stats.wins + winPositions) / allWins;
-		const auto allLosses = stats.losses + losses;
-		stats.lostGamesAveragePositionsTried = allLosses == 0 ? 0 : (stats.lostGamesAveragePositionsTried * stats.losses + lossPositions) / allLosses;
+	};
+
+	void _update_stats(const ResultTotals& totals, Stats& stats) {
+		stats.totalPositions += totals.allPositions;
+		stats.maxSolutionDepth = std::max(stats.maxSolutionDepth, totals.maxSolutionDepth);
+		stats.minSolutionDepth = std::min(stats.minSolutionDepth, totals.minSolutionDepth);
+
+		const auto allWins = stats.wins + totals.wins;
+		stats.wonGamesAveragePositionsTried = allWins == 0 ? 0 : (stats.wonGamesAveragePositionsTried * stats.wins + totals.winPositions) / allWins;
+		const auto allLosses = stats.losses + totals.losses;
+		stats.lostGamesAveragePositionsTried = allLosses == 0 ? 0 : (stats.lostGamesAveragePositionsTried * stats.losses + totals.lossPositions) / allLosses;
 		const auto totalCompletedGames = allWins + allLosses;
-		stats.completedGamesAveragePositionsTried = totalCompletedGames == 0 ? 0 : (stats.completedGamesAveragePositionsTried * (stats.wins + stats.losses) + winPositions + lossPositions) / totalCompletedGames;
+		stats.completedGamesAveragePositionsTried = totalCompletedGames == 0 ? 0 : (stats.completedGamesAveragePositionsTried * (stats.wins + stats.losses) + totals.winPositions + totals.lossPositions) / totalCompletedGames;
 
-		stats.averageSolutionDepth = allWins == 0 ? 0 : (stats.averageSolutionDepth * stats.wins + solutionLengths) / allWins;
+		stats.averageSolutionDepth = allWins == 0 ? 0 : (stats.averageSolutionDepth * stats.wins + totals.solutionLengths) / allWins;
 
-		stats.totalGames += results.size();
-		stats.wins += wins;
-		stats.losses += losses;
-		stats.unknown += unknown;
+		stats.totalGames += totals.wins + totals.losses + totals.unknown;
+		stats.wins += totals.wins;
+		stats.losses += totals.losses;
+		stats.unknown += totals.unknown;
+	}
+
+	void _update_stats(const std::vector<GameResult>& results, const std::vector<CachedResult>& cachedResults, bool usingCache, Stats& stats) {
+		ResultTotals totals;
+		for (const auto& r : results) {
+			totals.add(r.result, r.positionsTried, r.solution.size());
+			for (u8 i = 0; i < NUM_AUTO_MOVE_RULES; ++i)
+				stats.autoMoves[i] += r.autoMoves[i];
+			stats.endgame.attempts += r.endgame.attempts;
+			stats.endgame.playOuts += r.endgame.playOuts;
+			stats.endgame.moves += r.endgame.moves;
+			stats.sleepingMovesSkipped += r.sleepingMovesSkipped;
+			if (r.approximate && r.result == GameResult::Result::LOSE)
+				++stats.probableLosses;
+		}
+		// Cached results count towards the game stats, but not the positions solved by this run.
+		u64 cachedPositions = 0;
+		for (const auto& r : cachedResults) {
+			totals.add(_to_result(r.outcome), r.positionsTried, r.solutionLength);
+			cachedPositions += r.positionsTried;
+		}
+		totals.allPositions -= cachedPositions;
+		if (usingCache) {
+			stats.cacheLookups += results.size() + cachedResults.size();
+			stats.cacheHits += cachedResults.size();
+		}
+		_update_stats(totals, stats);
 	}
 
 	void _print_options(const BatchOptions& options, u32 numSolvers) {
@@ -199,32 +317,112 @@ namespace {
 		if (options.maxStates == 0)
 			std::cout << "(infinite)";
 		std::cout << "\n";
+		std::cout << "Draw:       " << PadWrite(static_cast<u32>(options.drawCount)) << "\n";
+		std::cout << "Auto-moves: " << AutoMoveRulesToStr(options.autoMoveRules) << "\n";
+		if (options.stateFilterMegabytes > 0)
+			std::cout << "Seen states: approximate filter of " << options.stateFilterMegabytes << "MB per solver (false positive rate " << options.stateFilterFalsePositives << ")\n";
 		std::cout << "Solvers:    " << PadWrite(static_cast<u32>(options.numSolvers));
 		if (options.numSolvers == 0)
 			std::cout << " (deduced to " << numSolvers << ")";
 		std::cout << "\n";
+		if (options.pinThreads)
+			std::cout << "Pinning solver threads to cores.\n";
+		if (!options.traceFilePath.empty())
+			std::cout << "Tracing every " << std::max<u32>(options.traceEvery, 1) << " batches to: " << options.traceFilePath << "\n";
+		if (!options.cacheDirectory.empty())
+			std::cout << "Result cache: " << options.cacheDirectory << "\n";
 		std::cout << "Results directory: " << options.outputDirectory << "\n";
 		std::cout << (options.writeGameSolutions ? "Writing out game solutions.\n" : "Not writing out game solutions.\n");
 
 		if (!options.seedFilePath.empty()) {
 			std::cout << "Running from seed file: " << options.seedFilePath << "\n";
 		}
+		if (!options.prioritiesFilePath.empty()) {
+			std::cout << "Using move priorities from: " << options.prioritiesFilePath << "\n";
+		}
 
 		std::cout << std::endl;
 	}
 
-	void _batch_task(KlondikeSolver& solver, std::mutex& writeMutex, size_t& seedIndex, const std::vector<u64>& seeds, GameResults& workingResults, std::atomic<u32>& seedsRun) {
+	// Reads batches of seeds from a seed file, with batch 0 starting at the first seed to run.
+	class SeedFileBatches {
+	public:
+		bool open(const std::string& path, u64 firstSeed, u32 batchSize) {
+			file_.open(path);
+			if (!file_.is_open()) {
+				std::cerr << "BatchRunner::run: Failed to open seed file.\n";
+				return false;
+			}
+			batch_size_ = batchSize;
+			// Find the first seed. If it isn't there, there are no batches to run.
+			std::streampos pos = file_.tellg();
+			for (u64 seed; file_ >> seed; pos = file_.tellg()) {
+				if (seed == firstSeed) {
+					start_ = pos;
+					break;
+				}
+			}
+			file_.clear();
+			file_.seekg(start_);
+			return true;
+		}
+
+		// Leaves seeds empty if the batch is past the end of the file.
+		void read(u64 batch, std::vector<u64>& seeds) {
+			if (start_ == std::streampos(-1))
+				return;
+			if (batch < next_batch_) {
+				file_.clear();
+				file_.seekg(start_);
+				next_batch_ = 0;
+			}
+			u64 seed;
+			for (u64 skip = (batch - next_batch_) * batch_size_; skip > 0 && file_ >> seed; --skip) {}
+			for (u32 i = 0; i < batch_size_ && file_ >> seed; ++i)
+				seeds.push_back(seed);
+			next_batch_ = batch + 1;
+		}
+
+	private:
+		std::ifstream file_;
+		std::streampos start_{ -1 };
+		u32 batch_size_{ 0 };
+		u64 next_batch_{ 0 };
+	};
+
+	// Lock a mutex, tracing any time spent waiting for it.
+	std::unique_lock<std::mutex> _lock(std::mutex& mutex, TraceRecorder* trace) {
+		std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+		if (!lock.owns_lock()) {
+			TraceScope wait(trace, "lock wait");
+			lock.lock();
+		}
+		return lock;
+	}
+
+	template <typename Rules>
+	void _batch_task(KlondikeSolver<Rules>& solver, std::optional<u32> pinCore, TraceRecorder* trace, std::mutex& writeMutex, size_t& seedIndex, const std::vector<u64>& seeds, GameResults& workingResults, std::atomic<u32>& seedsRun) {
+		// Keep each solver on the same core from batch to batch, so its state table stays in memory local to that core.
+		if (pinCore && !PinThreadToCore(*pinCore)) {
+			static std::atomic_flag warned = ATOMIC_FLAG_INIT;
+			if (!warned.test_and_set())
+				std::cerr << "Failed to pin solver threads to cores. Running unpinned.\n";
+		}
 		size_t seedToRunIndex = 0;
 		{
-			std::lock_guard<std::mutex> lock(writeMutex);
+			auto lock = _lock(writeMutex, trace);
 			seedToRunIndex = seedIndex++;
 		}
 		while (seedToRunIndex < seeds.size()) {
-			solver.setSeed(seeds[seedToRunIndex]);
-			auto result = solver.solve();
+			GameResult result;
+			{
+				TraceScope solve(trace, "solve", "seed", seeds[seedToRunIndex]);
+				solver.setSeed(seeds[seedToRunIndex]);
+				result = solver.solve();
+			}
 			++seedsRun;
 			{
-				std::lock_guard<std::mutex> lock(writeMutex);
+				auto lock = _lock(writeMutex, trace);
 				workingResults.emplace_back(std::move(result));
 				seedToRunIndex = seedIndex++;
 			}
@@ -233,113 +431,211 @@ namespace {
 }
 
 bool BatchRunner::run(bool printOptions) {
+	switch (options_.drawCount) {
+	case 1: return _run<DrawOneRules>(printOptions);
+	case 3: return _run<DrawThreeRules>(printOptions);
+	default:
+		std::cerr << "BatchRunner::run: Unsupported stock draw count (" << static_cast<u32>(options_.drawCount) << ").\n";
+		return false;
+	}
+}
+
+template <typename Rules>
+bool BatchRunner::_run(bool printOptions) {
 	if (!_startup(options_.outputDirectory))
 		return false;
 
 	const unsigned int numSolvers = options_.numSolvers > 0 ? options_.numSolvers : std::thread::hardware_concurrency();
 	const u32 numBatches = options_.numBatches > 0 ? options_.numBatches : std::numeric_limits<u32>::max();
 
+	MovePriorities priorities;
+	if (!options_.prioritiesFilePath.empty() && !LoadMovePriorities(options_.prioritiesFilePath, priorities))
+		return false;
+
 	if (printOptions)
 		_print_options(options_, numSolvers);
 
 	std::atomic<u32> seedsRun = 0;
 	Threadpool pool(numSolvers);
-	std::vector<KlondikeSolver> solvers(numSolvers, options_.maxStates);
+	std::vector<KlondikeSolver<Rules>> solvers(numSolvers, KlondikeSolver<Rules>(options_.maxStates, priorities));
+	for (auto& solver : solvers) {
+		solver.setAutoMoveRules(options_.autoMoveRules);
+		if (options_.stateFilterMegabytes > 0)
+			solver.setStateFilter(static_cast<std::size_t>(options_.stateFilterMegabytes) << 20, options_.stateFilterFalsePositives);
+	}
+	if (options_.stateFilterMegabytes > 0 && !solvers.front().getStateFilter().isEnabled()) {
+		std::cerr << "BatchRunner::run: The state filter's false positive rate must be between 0 and 1.\n";
+		return false;
+	}
 
 	std::vector<std::future<void>> threads;
 	threads.reserve(numSolvers);
 
 	std::mutex updateResultsMutex;
 	std::vector<GameResult> workingResults, writingResults;
+	std::vector<CachedResult> workingCached, writingCached;
 
-	std::ifstream seedFile;
-	if (!options_.seedFilePath.empty()) {
-		seedFile.open(options_.seedFilePath);
-		if (!seedFile.is_open()) {
-			std::cerr << "BatchRunner::run: Failed to open seed file.\n";
+	constexpr u32 cacheConfigKey = _cache_config_key<Rules>();
+	std::optional<ResultCache> cache;
+	if (!options_.cacheDirectory.empty()) {
+		cache.emplace();
+		if (!cache->open(options_.cacheDirectory))
 			return false;
-		}
 	}
 
-	u64 batchStartSeed = options_.firstSeed;
-	auto populateSeeds = [options = options_, &batchStartSeed, &seedFile] (std::vector<u64>& seeds, bool firstTime = false) {
+	SeedFileBatches seedFile;
+	if (!options_.seedFilePath.empty() && !seedFile.open(options_.seedFilePath, options_.firstSeed, options_.batchSize))
+		return false;
+
+	// Batches are numbered from the first seed. The shard (or the lease file) decides which of them this run does.
+	std::optional<LeaseFile> leases;
+	if (!options_.leaseFilePath.empty())
+		leases.emplace(options_.leaseFilePath, options_.firstSeed, options_.batchSize, options_.seedFilePath, options_.leaseTimeout);
+	u64 nextShardBatch = options_.shard.index;
+	auto populateSeeds = [options = options_, &nextShardBatch, &leases, &seedFile] (std::vector<u64>& seeds, u64& out_batch) {
+		if (leases) {
+			if (!leases->acquire(out_batch))
+				return false;
+		} else {
+			out_batch = nextShardBatch;
+			nextShardBatch += options.shard.count;
+		}
 		seeds.reserve(options.batchSize);
 		if (!options.seedFilePath.empty()) {
-			size_t i = 0;
-			u64 seed;
-			if (firstTime) {
-				// Find the first seed.
-				while (seedFile >> seed) {
-					if (seed == options.firstSeed) {
-						seeds.push_back(seed);
-						++i;
-						break;
-					}
-				}
-			}
-			while (i++ < options.batchSize && seedFile >> seed)
-				seeds.push_back(seed);
+			seedFile.read(out_batch, seeds);
 		} else {
-			const u64 batchEnd = batchStartSeed + options.batchSize;
-			while (batchStartSeed < batchEnd)
-				seeds.push_back(batchStartSeed++);
+			const u64 batchStart = options.firstSeed + out_batch * options.batchSize;
+			for (u64 seed = batchStart; seed < batchStart + options.batchSize; ++seed)
+				seeds.push_back(seed);
 		}
+		return true;
 	};
 
 	Stats stats;
-	stats.startSeed = options_.firstSeed;
+
+	std::unique_ptr<TraceRecorder> trace;
+	if (!options_.traceFilePath.empty()) {
+		trace = std::make_unique<TraceRecorder>();
+		trace->setThreadName("main");
+	}
+	auto exportTrace = [&trace, path = options_.traceFilePath] {
+		if (trace && trace->exportJson(path))
+			std::cout << "Trace written to: " << path << "\n";
+	};
 
 	const auto timeStart = Clock::now();
 
 	std::vector<u64> batchSeeds, tempBatchSeeds;
-
-	auto writeResults = [options = options_, timeStart, &stats, &writingResults, &batchSeeds] {
-		if (!writingResults.empty()) {
+	u64 batch{ 0 }, nextBatch{ 0 };
+	std::optional<u64> writingBatch;
+
+	auto writeResults = [options = options_, timeStart, &stats, &writingResults, &writingCached, &writingBatch, &leases, &cache, &trace] {
+		TraceScope write(trace.get(), "write results");
+		if (writingBatch && leases)
+			leases->complete(*writingBatch);
+		writingBatch.reset();
+		if (!writingResults.empty() || !writingCached.empty()) {
 			std::sort(writingResults.begin(), writingResults.end(), [](const auto& lhs, const auto& rhs) { return lhs.seed < rhs.seed; });
+			std::sort(writingCached.begin(), writingCached.end(), [](const auto& lhs, const auto& rhs) { return lhs.seed < rhs.seed; });
 
-			_write_results(writingResults, options.outputDirectory, options.writeGameSolutions);
+			_write_results(writingResults, writingCached, options.outputDirectory, options.writeGameSolutions);
+			if (cache) {
+				for (const GameResult& result : writingResults) {
+					if (!result.approximate || result.result == GameResult::Result::WIN)
+						cache->add(_to_cached(result, cacheConfigKey, options.maxStates));
+				}
+				cache->flush();
+			}
 
-			_update_stats(writingResults, stats);
-			stats.runTime = std::chrono::duration_cast<std::chrono::seconds>(Clock::now() - timeStart);
+			_update_stats(writingResults, writingCached, cache.has_value(), stats);
+			const auto runTime = Clock::now() - timeStart;
+			stats.runTime = std::chrono::duration_cast<std::chrono::seconds>(runTime);
+			stats.positionsPerSecond = static_cast<float>(stats.totalPositions / std::chrono::duration<double>(runTime).count());
 			_write_stats(options.outputDirectory, stats);
 
 			writingResults.clear();
+			writingCached.clear();
 		}
 	};
 
-	populateSeeds(tempBatchSeeds, true);
+	if (!populateSeeds(tempBatchSeeds, nextBatch))
+		return false;
 	for (u32 i = 1; i <= numBatches && !tempBatchSeeds.empty(); ++i) {
+		if (trace)
+			trace->setRecording((i - 1) % std::max<u32>(options_.traceEvery, 1) == 0);
+		TraceScope batchScope(trace.get(), "batch", "batch", nextBatch);
 		// Initialize data and spawn tasks for solvers.
 		size_t seedIndex = 0;
 		batchSeeds = std::move(tempBatchSeeds);
 		tempBatchSeeds.clear();
+		batch = nextBatch;
 		workingResults.reserve(options_.batchSize);
+		if (i == 1)
+			stats.startSeed = batchSeeds.front();
 		stats.endSeed = batchSeeds.back();
-		for (auto& solver : solvers)
-			threads.push_back(pool.add(_batch_task, std::ref(solver), std::ref(updateResultsMutex), std::ref(seedIndex), std::ref(batchSeeds), std::ref(workingResults), std::ref(seedsRun)));
+		if (cache) {
+			// Only solve the seeds without a usable cached result. Wins are solved again if their solutions are wanted.
+			auto isCached = [&](u64 seed) {
+				const auto cached = cache->find(seed, cacheConfigKey);
+				if (!cached || !IsReusable(*cached, options_.maxStates) || (options_.writeGameSolutions && cached->outcome == SeedOutcome::WIN))
+					return false;
+				workingCached.push_back(*cached);
+				return true;
+			};
+			batchSeeds.erase(std::remove_if(batchSeeds.begin(), batchSeeds.end(), isCached), batchSeeds.end());
+		}
+		for (u32 s = 0; s < solvers.size(); ++s) {
+			const std::optional<u32> pinCore = options_.pinThreads ? std::optional<u32>{ s } : std::nullopt;
+			threads.push_back(pool.add(_batch_task<Rules>, std::ref(solvers[s]), pinCore, trace.get(), std::ref(updateResultsMutex), std::ref(seedIndex), std::ref(batchSeeds), std::ref(workingResults), std::ref(seedsRun)));
+		}
 
 		// Output results, get seeds for next batch.
 		writeResults();
-		populateSeeds(tempBatchSeeds);
+		bool haveNextBatch = true;
+		if (i != numBatches) {
+			TraceScope populate(trace.get(), "get seeds");
+			haveNextBatch = populateSeeds(tempBatchSeeds, nextBatch);
+		}
 
 		// Wait for solvers to finish batch.
-		while (!pool.isIdle()) {
-			std::this_thread::sleep_for(std::chrono::milliseconds(500));
-			std::cout << "\rSeeds Run: " << PadWrite<u32>(seedsRun);
-		}
+		{
+			TraceScope wait(trace.get(), "wait for solvers");
+			while (!pool.isIdle()) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(500));
+				std::cout << "\rSeeds Run: " << PadWrite<u32>(seedsRun);
+			}
 
-		for (auto& thread : threads)
-			thread.get();
-		threads.clear();
+			for (auto& thread : threads)
+				thread.get();
+			threads.clear();
+		}
 
 		std::cout << "\nBatch " << i << " done. Writing results.\n";
 		// Move results so we can spawn new tasks before writing.
 		writingResults = std::move(workingResults);
 		workingResults.clear();
+		writingCached = std::move(workingCached);
+		workingCached.clear();
+		writingBatch = batch;
+		if (!haveNextBatch) {
+			writeResults();
+			exportTrace();
+			return false;
+		}
 	}
 	writeResults();
+	if (cache && !cache->compact())
+		std::cerr << "Failed to compact the result cache. New results are kept in its journal.\n";
 	std::cout << "All batches completed.\n";
 	std::cout << "Time: " << stats.runTime.count() << " seconds\n";
+	std::cout << "Positions per second: " << static_cast<u64>(stats.positionsPerSecond) << "\n";
+	if (cache)
+		std::cout << "Cache hits: " << stats.cacheHits << " of " << stats.cacheLookups << " seeds (" << cache->size() << " results cached).\n";
+	std::cout << (options_.stateFilterMegabytes > 0 ? "State filters used " : "State tables used ") << PageKindToStr(solvers.front().getStatePageKind()) << ".\n";
+	if (options_.stateFilterMegabytes > 0)
+		std::cout << "Each state filter holds " << solvers.front().getStateFilter().capacity() << " positions.\n";
+	std::cout << "Tableau matching used the " << TableauMatchKernel() << " kernel.\n";
+	exportTrace();
 
 	return true;
 }
@@ -374,3 +670,65 @@ bool BatchRunner::writeDecks(bool useNumericCards) const {
 
 	return true;
 }
+
+bool BatchRunner::mergeResults(const std::vector<std::string>& inputDirectories) const {
+	ResultsMerger merger;
+	for (const std::string& dir : inputDirectories) {
+		if (!merger.addDirectory(dir))
+			return false;
+	}
+	if (!_startup(options_.outputDirectory))
+		return false;
+
+	std::ofstream files[] = {
+		std::ofstream(options_.outputDirectory + std::string(SeedFileName(SeedOutcome::WIN)), std::ios::trunc),
+		std::ofstream(options_.outputDirectory + std::string(SeedFileName(SeedOutcome::LOSE)), std::ios::trunc),
+		std::ofstream(options_.outputDirectory + std::string(SeedFileName(SeedOutcome::UNKNOWN)), std::ios::trunc),
+	};
+	Stats stats;
+	stats.mergedDirectories = static_cast<u32>(inputDirectories.size());
+	ResultTotals totals;
+	auto onSeed = [&files, &stats, &totals](const SeedLine& result) {
+		if (totals.wins + totals.losses + totals.unknown == 0)
+			stats.startSeed = result.seed;
+		stats.endSeed = result.seed;
+		files[toUType(result.outcome)] << result.line << "\n";
+		totals.add(_to_result(result.outcome), result.positionsTried, result.solutionLength);
+	};
+	auto onConflict = [](const std::vector<SeedLine>& lines) {
+		std::cerr << "BatchRunner::mergeResults: Conflicting results for seed " << lines.front().seed << ".\n";
+	};
+	MergeSummary summary;
+	if (!merger.merge(onSeed, onConflict, summary))
+		return false;
+	if (summary.seeds == 0) {
+		std::cerr << "BatchRunner::mergeResults: No results found to merge.\n";
+		return false;
+	}
+	_update_stats(totals, stats);
+	_write_stats(options_.outputDirectory, stats, std::ios::trunc);
+
+	std::cout << "Merged " << summary.seeds << " seeds (" << summary.duplicates << " duplicates, " << summary.conflicts << " conflicts) into " << options_.outputDirectory << "\n";
+	return summary.conflicts == 0;
+}
+
+bool BatchRunner::renderSolution(u64 seed, std::ostream& output) const {
+	const std::string archivePath = options_.outputDirectory + std::string(SOLUTIONS_ARCHIVE_FILE);
+	std::ifstream archive(archivePath);
+	if (!archive.is_open()) {
+		std::cerr << "BatchRunner::renderSolution: Failed to open solutions archive: " << archivePath << "\n";
+		return false;
+	}
+	MoveList solution;
+	if (!FindSolution(archive, seed, solution)) {
+		std::cerr << "BatchRunner::renderSolution: No solution for seed " << seed << " in " << archivePath << "\n";
+		return false;
+	}
+	switch (options_.drawCount) {
+	case 1: return _render_solution<DrawOneRules>(output, seed, solution);
+	case 3: return _render_solution<DrawThreeRules>(output, seed, solution);
+	default:
+		std::cerr << "BatchRunner::renderSolution: Unsupported stock draw count (" << static_cast<u32>(options_.drawCount) << ").\n";
+		return false;
+	}
+}
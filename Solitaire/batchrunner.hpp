@@ -1,9 +1,14 @@
 #pragma once
 
 #include "units.hpp"
+#include "AutoMoveRules.hpp"
+#include "Sharding.hpp"
 
 #include <optional>
+#include <ostream>
+#include <string>
 #include <string_view>
+#include <vector>
 
 // Batch runner for Solitaire Klondike. Runs batches of games and writes out results to disk.
 
@@ -14,10 +19,26 @@ namespace solitaire {
 		u32 batchSize{ 100 };
 		u64 maxStates{ 1000000 };
 		u8 numSolvers{ 4 };
+		u8 drawCount{ 3 }; // Number of cards dealt from the stock at a time. Selects the ruleset the solvers are compiled for.
+		AutoMoveRuleSet autoMoveRules{ DEFAULT_AUTO_MOVE_RULES };
 
-		bool writeGameSolutions{ false };
+		ShardSpec shard;              // Which batches of the sweep to run (when not using a lease file).
+		std::string leaseFilePath;    // If set, batches are leased from this file, shared with other runs of the same sweep.
+		u64 leaseTimeout{ 0 };        // Seconds before an unfinished lease is handed out again. 0 to never.
+
+		u64 stateFilterMegabytes{ 0 };        // If set, each solver keeps seen states in an approximate filter of this size (see StateFilter).
+		double stateFilterFalsePositives{ 0.001 };
+
+		std::string cacheDirectory;   // If set, results are cached here, and seeds with a usable cached result aren't solved again.
+
+		std::string traceFilePath;    // If set, a timeline of the run is written here as Chrome trace event JSON.
+		u32 traceEvery{ 1 };          // Trace every nth batch.
+
+		bool pinThreads{ false }; // Pin each solver to its own core.
+		bool writeGameSolutions{ false }; // Append winning solutions to the solutions archive.
 		std::string outputDirectory{ "./results/" };
 		std::string seedFilePath;
+		std::string prioritiesFilePath; // Move priorities for the solvers (EG from the priority tuner). Uses the defaults if not set.
 	};
 
 	class BatchRunner {
@@ -30,8 +51,16 @@ namespace solitaire {
 		// Returns false if there is an error.
 		bool         run(bool printOptions = true);
 		bool         writeDecks(bool useNumericCards = false) const;
+		// Write a seed's archived solution as a walkthrough: the moves, then the board after each one.
+		bool         renderSolution(u64 seed, std::ostream& output) const;
+		// Merge the results of several runs (EG shards of one sweep) into the output directory, with a new stats file.
+		// Returns false if there is an error, or the runs have conflicting results.
+		bool         mergeResults(const std::vector<std::string>& inputDirectories) const;
 
 	private:
+		template <typename Rules>
+		bool _run(bool printOptions);
+
 		BatchOptions options_;
 	};
 }
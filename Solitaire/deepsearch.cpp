@@ -0,0 +1,117 @@
+#include "deepsearch.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+
+#include "KlondikeSolver.hpp"
+#include "MovePriorities.hpp"
+#include "SolutionArchive.hpp"
+#include "StateStore.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+using namespace solitaire;
+
+namespace {
+	constexpr const char* CHECKPOINT_FILE = "checkpoint.bin";
+	constexpr u64 SLICE_STATES = 1'000'000; // Positions searched between progress reports and checkpoint checks.
+
+	const char* _result_to_str(GameResult::Result result) {
+		constexpr const char* NAMES[] = { "WIN", "LOSE", "UNKNOWN" };
+		return NAMES[toUType(result)];
+	}
+}
+
+bool DeepSearch::run() {
+	switch (options_.drawCount) {
+	case 1: return _run<DrawOneRules>();
+	case 3: return _run<DrawThreeRules>();
+	default:
+		std::cerr << "DeepSearch::run: Unsupported stock draw count (" << static_cast<u32>(options_.drawCount) << ").\n";
+		return false;
+	}
+}
+
+template <typename Rules>
+bool DeepSearch::_run() {
+	MovePriorities priorities;
+	if (!options_.prioritiesFilePath.empty() && !LoadMovePriorities(options_.prioritiesFilePath, priorities))
+		return false;
+
+	StateStore store;
+	if (!store.open(options_.directory, static_cast<std::size_t>(options_.memoryMegabytes) << 20))
+		return false;
+	KlondikeSolver<Rules> solver(options_.maxStates, priorities);
+	solver.setAutoMoveRules(options_.autoMoveRules);
+	solver.setStateStore(&store);
+
+	std::string directory = options_.directory;
+	if (!directory.empty() && directory.back() != '/' && directory.back() != '\\')
+		directory += '/';
+	const std::string checkpointPath = directory + CHECKPOINT_FILE;
+	std::error_code error;
+	if (std::filesystem::exists(checkpointPath, error)) {
+		std::string searchState;
+		if (!store.readCheckpoint(checkpointPath, searchState))
+			return false;
+		std::istringstream stateStream(searchState);
+		if (!solver.readCheckpoint(stateStream))
+			return false;
+		if (solver.getSeed() != options_.seed) {
+			std::cerr << "DeepSearch::run: " << directory << " holds a search of seed " << solver.getSeed() << ". Finish it, or use another directory.\n";
+			return false;
+		}
+		std::cout << "Resuming seed " << options_.seed << " from its checkpoint, after " << solver.getStatesTried() << " positions (" << store.diskSize() << " on disk).\n";
+	} else {
+		store.clear();
+		solver.setSeed(options_.seed);
+		std::cout << "Searching seed " << options_.seed << " with " << options_.memoryMegabytes << "MB of memory, checkpointing to " << directory << " every "
+			<< options_.checkpointSeconds << " seconds.\n";
+	}
+
+	auto checkpoint = [&solver, &store, &checkpointPath] {
+		std::ostringstream searchState;
+		return solver.writeCheckpoint(searchState) && store.writeCheckpoint(checkpointPath, searchState.str());
+	};
+
+	std::optional<GameResult> result;
+	auto lastCheckpoint = Clock::now();
+	const auto timeStart = lastCheckpoint;
+	try {
+		while (!(result = solver.solveFor(SLICE_STATES))) {
+			std::cout << "\rPositions tried: " << solver.getStatesTried() << " (seen: " << store.size() << ", on disk: " << store.diskSize()
+				<< " in " << store.numRuns() << " runs)" << std::flush;
+			if (Clock::now() - lastCheckpoint >= std::chrono::seconds(options_.checkpointSeconds)) {
+				if (!checkpoint())
+					return false;
+				lastCheckpoint = Clock::now();
+			}
+		}
+	} catch (const std::runtime_error& e) {
+		std::cerr << "\n" << e.what() << " The search can be resumed from the last checkpoint.\n";
+		return false;
+	}
+	const double seconds = std::chrono::duration<double>(Clock::now() - timeStart).count();
+
+	std::cout << "\nSeed " << result->seed << ": " << _result_to_str(result->result) << " after " << result->positionsTried << " positions";
+	if (result->result == GameResult::Result::WIN)
+		std::cout << ", solution length: " << result->solution.size();
+	std::cout << " (" << static_cast<u64>(seconds) << " seconds this run).\n";
+	if (options_.writeGameSolution && result->result == GameResult::Result::WIN) {
+		std::filesystem::create_directories(options_.outputDirectory, error);
+		std::ofstream archive(options_.outputDirectory + std::string(SOLUTIONS_ARCHIVE_FILE), std::ios::app);
+		WriteSolution(archive, result->seed, result->solution);
+		if (!archive) {
+			std::cerr << "DeepSearch::run: Failed to write the solution to the archive.\n";
+			return false;
+		}
+	}
+	store.clear();
+	std::filesystem::remove(checkpointPath, error);
+	return true;
+}
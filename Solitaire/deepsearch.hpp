@@ -0,0 +1,41 @@
+#pragma once
+
+#include "units.hpp"
+#include "AutoMoveRules.hpp"
+
+#include <string>
+
+// Searches a single seed for as long as it takes, under a fixed memory budget. Seen states spill to sorted runs on disk (see StateStore),
+// and the search is checkpointed as it goes, so it can be stopped and resumed after a restart.
+
+namespace solitaire {
+	struct DeepSearchOptions {
+		u64 seed{ 0 };
+		std::string directory{ "./deep/" };  // Holds the state runs and the checkpoint. One seed at a time.
+		u64 memoryMegabytes{ 1024 };         // For the in-memory states, and the filters in front of the runs on disk.
+		u32 checkpointSeconds{ 300 };
+		u64 maxStates{ 0 };                  // 0 for infinite.
+		u8 drawCount{ 3 };
+		AutoMoveRuleSet autoMoveRules{ DEFAULT_AUTO_MOVE_RULES };
+		std::string prioritiesFilePath;
+		bool writeGameSolution{ false };     // Append a winning solution to the solutions archive in the output directory.
+		std::string outputDirectory{ "./results/" };
+	};
+
+	// Picks up from the checkpoint in the directory if there is one (it must be for the same seed), otherwise starts a new search.
+	// The directory is emptied once the search ends.
+	class DeepSearch {
+	public:
+		DeepSearch() = default;
+		DeepSearch(DeepSearchOptions options) : options_(std::move(options)) {}
+
+		// Returns false if there is an error.
+		bool run();
+
+	private:
+		template <typename Rules>
+		bool _run();
+
+		DeepSearchOptions options_;
+	};
+}
@@ -1,5 +1,12 @@
 #include "CmdParser/CmdParser.hpp"
 #include "batchrunner.hpp"
+#include "deepsearch.hpp"
+#include "sampler.hpp"
+#include "SolutionArchive.hpp"
+#include "tuner.hpp"
+#include "verifier.hpp"
+
+#include <sstream>
 
 int main(int argc, const char* argv[]) {
 	using namespace solitaire;
@@ -12,28 +19,143 @@ int main(int argc, const char* argv[]) {
 	parser.push(options.batchSize, 'b', "batch-size", u32{ 1000 }, "How many seeds to run per batch.");
 	parser.push(options.maxStates, 's', "max-states", solitaire::u64{ 10'000'000 }, "Maximum number of states to try before giving up. 0 for infinite. Correlates to ram usage.");
 	parser.push(options.numSolvers, 't', "num-solvers", u8{ 0 }, "How many solvers to run. Solvers run on separate threads. 0 to auto-deduce.");
-	parser.pushFlag(options.writeGameSolutions, std::nullopt, "write-game-solutions", false, "Write out the winning game solutions to files.");
+	parser.push(options.drawCount, 'd', "draw", u8{ 3 }, "How many cards to deal from the stock at a time (1 or 3).");
+	parser.pushFlag(options.pinThreads, std::nullopt, "affinity", false, "Pin each solver thread to its own core, keeping its memory local on multi-socket machines.");
+	std::string shard;
+	parser.push(shard, std::nullopt, "shard", "0/1", "Run shard i of N (\"i/N\"): every Nth batch from the first seed, starting with batch i. Other shards can run elsewhere.");
+	parser.push(options.leaseFilePath, std::nullopt, "lease-file", "", "Relative path to a lease file shared by runs of the same sweep. Each run leases the next batch from it (instead of --shard).");
+	parser.push(options.leaseTimeout, std::nullopt, "lease-timeout", u64{ 0 }, "Lease file option: seconds before an unfinished batch is leased to another run. 0 for never.");
+	parser.push(options.traceFilePath, std::nullopt, "trace", "", "Relative path to write a timeline of the run to, as Chrome trace event JSON (for chrome://tracing or Perfetto).");
+	parser.push(options.traceEvery, std::nullopt, "trace-every", u32{ 1 }, "Trace option: only trace every nth batch, to keep the overhead down on long runs.");
+	parser.push(options.stateFilterMegabytes, std::nullopt, "state-filter", u64{ 0 }, "Keep each solver's seen states in an approximate filter of this many MB, to search many more positions. Losses found are only probable.");
+	parser.push(options.stateFilterFalsePositives, std::nullopt, "state-filter-fp", 0.001, "State filter option: chance of a new position being taken as seen. Sets how many positions the filter holds.");
+	parser.push(options.cacheDirectory, std::nullopt, "cache", "", "Relative path to a result cache directory. Seeds already solved for this ruleset are read from it instead of solved again.");
+	std::string mergeDirs;
+	parser.push(mergeDirs, std::nullopt, "merge", "", "Comma separated result directories (EG from shards) to merge into the output directory, instead of running.");
+	std::string autoMoves;
+	parser.push(autoMoves, std::nullopt, "auto-moves", "foundation,king", "Comma separated auto-move rules the solvers use: foundation, king, draw-one-stock, forced (or none).");
+	parser.pushFlag(options.writeGameSolutions, std::nullopt, "write-game-solutions", false, "Append winning game solutions to the solutions archive (solutions.txt) in the output directory.");
 	parser.push(options.outputDirectory, 'o', "output-dir", "./results/", "Relative path to save output to.");
 	parser.push(options.seedFilePath, 'F', "seed-file", "", "Relative path to seed file. If set, searches for first seed and starts from there.");
+	parser.push(options.prioritiesFilePath, 'p', "priorities", "", "Relative path to a move priorities file (EG written by --tune). Uses the built-in priorities if not set.");
 
 	bool writeDecks, useNumericCards;
 	parser.pushFlag(writeDecks, std::nullopt, "write-decks", false, "Generate decks for all seeds in a seed file, and write them out to a deck file.");
 	parser.pushFlag(useNumericCards, std::nullopt, "use-numeric-cards", false, "Write decks option: print cards as numbers [1,52]. Order: hearts->diamonds->clubs->spades.");
 
+	bool tune;
+	TuneOptions tuneOptions;
+	parser.pushFlag(tune, std::nullopt, "tune", false, "Tune the move priorities over a corpus of seeds, starting from --first (or the seed file), and write them out.");
+	parser.push(tuneOptions.numSeeds, std::nullopt, "tune-seeds", u32{ 500 }, "Tune option: how many seeds are in the training corpus.");
+	parser.push(tuneOptions.maxRounds, std::nullopt, "tune-rounds", u32{ 20 }, "Tune option: maximum rounds of coordinate descent.");
+	parser.push(tuneOptions.outputPath, std::nullopt, "tune-output", "./priorities.txt", "Tune option: relative path to write the tuned priorities to.");
+
+	bool sample;
+	SampleOptions sampleOptions;
+	parser.pushFlag(sample, std::nullopt, "sample", false, "Estimate the win, loss and unknown rates from seeds drawn at random from --first on (or the seed file), instead of running them all.");
+	parser.push(sampleOptions.range, std::nullopt, "sample-range", u64{ 1'000'000'000 }, "Sample option: how many seeds from the first seed to draw from, without a seed file.");
+	parser.push(sampleOptions.precision, std::nullopt, "sample-precision", 0.005, "Sample option: stop once each rate's confidence interval is within this of it (0.005 for +-0.5%).");
+	parser.push(sampleOptions.confidence, std::nullopt, "sample-confidence", 0.95, "Sample option: confidence level of the intervals.");
+	parser.push(sampleOptions.maxSamples, std::nullopt, "sample-max", u64{ 0 }, "Sample option: most seeds to solve, even short of the precision. 0 for no limit.");
+	parser.push(sampleOptions.randomSeed, std::nullopt, "sample-random-seed", u64{ 1 }, "Sample option: seed for drawing the seeds, so a run can be repeated.");
+
+	std::string deepSeed;
+	DeepSearchOptions deepOptions;
+	parser.push(deepSeed, std::nullopt, "deep", "", "Search one seed under a fixed memory budget, spilling seen states to disk, and checkpointing so it can be resumed. Use with --max-states 0 to search until solved.");
+	parser.push(deepOptions.directory, std::nullopt, "deep-dir", "./deep/", "Deep search option: relative path to keep seen states and the checkpoint in. Running again resumes the search.");
+	parser.push(deepOptions.memoryMegabytes, std::nullopt, "deep-memory", u64{ 1024 }, "Deep search option: MB of memory for seen states, before they spill to disk.");
+	parser.push(deepOptions.checkpointSeconds, std::nullopt, "checkpoint-every", u32{ 300 }, "Deep search option: seconds between checkpoints.");
+
+	std::string renderSeed;
+	parser.push(renderSeed, std::nullopt, "render", "", "Print the board walkthrough of a seed's solution, from the solutions archive in the output directory.");
+	bool verify;
+	parser.pushFlag(verify, std::nullopt, "verify", false, "Replay every solution in the output directory's solutions archive with full rules checks, and report any that are invalid.");
+
 	constexpr std::string_view description = "Solitaire Solver:\nAttempts to determine if Klondike games are winnable or not.";
 	if (!parser.parse(argc, argv) || showHelp) {
 		parser.printHelp(description);
 		return 1;
+	} else if (!ParseAutoMoveRules(autoMoves, options.autoMoveRules)) {
+		std::cerr << "Unknown auto-move rule in: " << autoMoves << "\n";
+		parser.printHelp(description);
+		return 1;
+	} else if (!ParseShardSpec(shard, options.shard)) {
+		std::cerr << "Invalid shard: " << shard << "\n";
+		parser.printHelp(description);
+		return 1;
 	} else if (writeDecks && options.seedFilePath.empty()) {
 		std::cerr << "Seed file must be set to write decks.\n";
 		parser.printHelp(description);
 		return 1;
 	}
 
+	if (tune) {
+		tuneOptions.firstSeed = options.firstSeed;
+		tuneOptions.maxStates = options.maxStates;
+		tuneOptions.numSolvers = options.numSolvers;
+		tuneOptions.drawCount = options.drawCount;
+		tuneOptions.autoMoveRules = options.autoMoveRules;
+		tuneOptions.seedFilePath = options.seedFilePath;
+		tuneOptions.prioritiesFilePath = options.prioritiesFilePath;
+		return solitaire::PriorityTuner(tuneOptions).run() ? 0 : 1;
+	}
+
+	if (sample) {
+		sampleOptions.firstSeed = options.firstSeed;
+		sampleOptions.seedFilePath = options.seedFilePath;
+		sampleOptions.maxStates = options.maxStates;
+		sampleOptions.numSolvers = options.numSolvers;
+		sampleOptions.drawCount = options.drawCount;
+		sampleOptions.autoMoveRules = options.autoMoveRules;
+		sampleOptions.prioritiesFilePath = options.prioritiesFilePath;
+		sampleOptions.batchSize = options.batchSize;
+		return solitaire::SeedSampler(sampleOptions).run() ? 0 : 1;
+	}
+
+	if (!deepSeed.empty()) {
+		if (std::stringstream seedStream(deepSeed); !(seedStream >> deepOptions.seed)) {
+			std::cerr << "Invalid seed to search: " << deepSeed << "\n";
+			return 1;
+		}
+		deepOptions.maxStates = options.maxStates;
+		deepOptions.drawCount = options.drawCount;
+		deepOptions.autoMoveRules = options.autoMoveRules;
+		deepOptions.prioritiesFilePath = options.prioritiesFilePath;
+		deepOptions.writeGameSolution = options.writeGameSolutions;
+		deepOptions.outputDirectory = options.outputDirectory;
+		return solitaire::DeepSearch(deepOptions).run() ? 0 : 1;
+	}
+
+	if (!renderSeed.empty()) {
+		u64 seed;
+		if (std::stringstream seedStream(renderSeed); !(seedStream >> seed)) {
+			std::cerr << "Invalid seed to render: " << renderSeed << "\n";
+			return 1;
+		}
+		return solitaire::BatchRunner(options).renderSolution(seed, std::cout) ? 0 : 1;
+	}
+	if (verify) {
+		VerifyOptions verifyOptions;
+		verifyOptions.archivePath = options.outputDirectory + std::string(SOLUTIONS_ARCHIVE_FILE);
+		verifyOptions.invalidPath = options.outputDirectory + "invalid_solutions.txt";
+		verifyOptions.numThreads = options.numSolvers;
+		verifyOptions.drawCount = options.drawCount;
+		return solitaire::SolutionVerifier(verifyOptions).run() ? 0 : 1;
+	}
+
 	solitaire::BatchRunner batchRunner(options);
 	if (writeDecks) {
 		return batchRunner.writeDecks(useNumericCards) ? 0 : 1;
 	}
+	if (!mergeDirs.empty()) {
+		std::vector<std::string> dirs;
+		std::stringstream list(mergeDirs);
+		for (std::string dir; std::getline(list, dir, ',');) {
+			if (!dir.empty())
+				dirs.push_back(dir);
+		}
+		return batchRunner.mergeResults(dirs) ? 0 : 1;
+	}
 
 	return batchRunner.run() ? 0 : 1;
 }
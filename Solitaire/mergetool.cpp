@@ -0,0 +1,76 @@
+#include "CmdParser/CmdParser.hpp"
+#include "ResultsMerge.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// Merges the seed files of any number of batch runner output directories into one sorted set, without loading them into memory.
+
+int main(int argc, const char* argv[]) {
+	using namespace solitaire;
+	bool showHelp, seedsOnly;
+	std::string inputs, outputDirectory;
+	cmd::CmdParser parser;
+	parser.pushFlag(showHelp, '?', "help", false, "Prints this help message.");
+	parser.push(inputs, 'i', "input", "./", "Comma separated directories to search (recursively) for seed files.");
+	parser.push(outputDirectory, 'o', "output-dir", "./", "Relative path to write the merged seed files to.");
+	parser.pushFlag(seedsOnly, std::nullopt, "seeds-only", false, "Write only the seeds (usable as a seed file), instead of the full result lines.");
+
+	constexpr std::string_view description = "Solitaire Results Merger:\nMerges winning/losing/unknown_seeds.txt files, removing duplicate seeds and reporting conflicts.";
+	if (!parser.parse(argc, argv) || showHelp) {
+		parser.printHelp(description);
+		return 1;
+	}
+	if (!outputDirectory.empty() && outputDirectory.back() != '/' && outputDirectory.back() != '\\')
+		outputDirectory += '/';
+
+	ResultsMerger merger;
+	std::stringstream list(inputs);
+	for (std::string dir; std::getline(list, dir, ',');) {
+		if (dir.empty())
+			continue;
+		std::cout << "Getting seed files from: " << dir << "\n";
+		if (!merger.addDirectory(dir, true))
+			return 1;
+	}
+
+	// Write to a different name than the inputs, as the output directory may be one of them.
+	const std::string suffix = seedsOnly ? "_list.txt" : "_merged.txt";
+	auto outputPath = [&outputDirectory, &suffix](SeedOutcome outcome) {
+		std::string name(SeedFileName(outcome));
+		return outputDirectory + name.substr(0, name.size() - 4) + suffix;
+	};
+	std::ofstream files[] = {
+		std::ofstream(outputPath(SeedOutcome::WIN), std::ios::trunc),
+		std::ofstream(outputPath(SeedOutcome::LOSE), std::ios::trunc),
+		std::ofstream(outputPath(SeedOutcome::UNKNOWN), std::ios::trunc),
+	};
+	std::ofstream conflictsFile(outputDirectory + "conflicts.txt", std::ios::trunc);
+	for (const auto& file : files) {
+		if (!file.is_open() || !conflictsFile.is_open()) {
+			std::cerr << "Failed to open output files in: " << outputDirectory << "\n";
+			return 1;
+		}
+	}
+
+	auto onSeed = [&files, seedsOnly](const SeedLine& result) {
+		auto& file = files[toUType(result.outcome)];
+		if (seedsOnly)
+			file << result.seed << "\n";
+		else
+			file << result.line << "\n";
+	};
+	auto onConflict = [&conflictsFile](const std::vector<SeedLine>& lines) {
+		for (const SeedLine& line : lines)
+			conflictsFile << SeedOutcomeToStr(line.outcome) << " " << line.line << "\n";
+	};
+	MergeSummary summary;
+	if (!merger.merge(onSeed, onConflict, summary))
+		return 1;
+
+	std::cout << "Merged " << summary.seeds << " seeds (" << summary.duplicates << " duplicates, " << summary.conflicts << " conflicts).\n";
+	if (summary.conflicts > 0)
+		std::cout << "Conflicting seeds written to: " << outputDirectory << "conflicts.txt\n";
+	return summary.conflicts == 0 ? 0 : 2;
+}
@@ -0,0 +1,208 @@
+#include "sampler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "KlondikeSolver.hpp"
+#include "MovePriorities.hpp"
+#include "threadpool/threadpool/Threadpool.hpp"
+
+using Clock = std::chrono::high_resolution_clock;
+
+using namespace solitaire;
+
+namespace {
+	constexpr u8 NUM_RESULTS = 3; // Indexed by GameResult::Result.
+	constexpr const char* RESULT_NAMES[NUM_RESULTS] = { "Wins", "Losses", "Unknown" };
+
+	struct Interval {
+		double estimate{ 0 };
+		double low{ 0 };
+		double high{ 0 };
+	};
+
+	// Draws indices in [0, size) without replacement, in O(draws) memory: a Fisher-Yates shuffle that only stores the swapped entries.
+	class IndexDrawer {
+	public:
+		IndexDrawer(u64 size, u64 randomSeed) : size_(size), rng_(randomSeed) {}
+
+		u64 remaining() const { return size_ - drawn_; }
+		u64 draw() {
+			const u64 pick = std::uniform_int_distribution<u64>(drawn_, size_ - 1)(rng_);
+			const u64 index = _at(pick);
+			swapped_[pick] = _at(drawn_);
+			++drawn_;
+			return index;
+		}
+
+	private:
+		u64 _at(u64 i) const {
+			const auto it = swapped_.find(i);
+			return it == swapped_.end() ? i : it->second;
+		}
+
+		u64 size_;
+		u64 drawn_{ 0 };
+		std::mt19937_64 rng_;
+		std::unordered_map<u64, u64> swapped_;
+	};
+
+	// Z score of a two sided interval, found by bisection on the normal distribution's CDF.
+	double _z_score(double confidence) {
+		double low = 0, high = 10;
+		for (u32 i = 0; i < 100; ++i) {
+			const double mid = (low + high) / 2;
+			(std::erf(mid / std::sqrt(2.0)) < confidence ? low : high) = mid;
+		}
+		return (low + high) / 2;
+	}
+
+	// Wilson score interval, which stays inside [0, 1] and behaves for rates near 0 or 1, unlike the normal approximation.
+	Interval _wilson_interval(u64 count, u64 samples, double z) {
+		if (samples == 0)
+			return Interval{ 0, 0, 1 };
+		const double n = static_cast<double>(samples);
+		const double p = count / n;
+		const double z2 = z * z;
+		const double centre = (p + z2 / (2 * n)) / (1 + z2 / n);
+		const double halfWidth = z / (1 + z2 / n) * std::sqrt(p * (1 - p) / n + z2 / (4 * n * n));
+		return Interval{ p, std::max(0.0, centre - halfWidth), std::min(1.0, centre + halfWidth) };
+	}
+
+	bool _load_seeds(const SampleOptions& options, std::vector<u64>& out_seeds) {
+		std::ifstream seedFile(options.seedFilePath);
+		if (!seedFile.is_open()) {
+			std::cerr << "SeedSampler: Failed to open seed file.\n";
+			return false;
+		}
+		u64 seed;
+		bool foundFirst = false;
+		while (seedFile >> seed) {
+			foundFirst = foundFirst || seed == options.firstSeed;
+			if (foundFirst)
+				out_seeds.push_back(seed);
+		}
+		if (out_seeds.empty()) {
+			std::cerr << "SeedSampler: No seeds found in seed file.\n";
+			return false;
+		}
+		return true;
+	}
+
+	void _print_percent(double rate) {
+		std::cout << std::fixed << std::setprecision(2) << rate * 100 << "%";
+	}
+}
+
+bool SeedSampler::run() {
+	switch (options_.drawCount) {
+	case 1: return _run<DrawOneRules>();
+	case 3: return _run<DrawThreeRules>();
+	default:
+		std::cerr << "SeedSampler::run: Unsupported stock draw count (" << static_cast<u32>(options_.drawCount) << ").\n";
+		return false;
+	}
+}
+
+template <typename Rules>
+bool SeedSampler::_run() {
+	if (options_.confidence <= 0 || options_.confidence >= 1 || options_.precision <= 0) {
+		std::cerr << "SeedSampler::run: Confidence must be between 0 and 1, and precision above 0.\n";
+		return false;
+	}
+	MovePriorities priorities;
+	if (!options_.prioritiesFilePath.empty() && !LoadMovePriorities(options_.prioritiesFilePath, priorities))
+		return false;
+
+	std::vector<u64> fileSeeds;
+	if (!options_.seedFilePath.empty() && !_load_seeds(options_, fileSeeds))
+		return false;
+	const u64 population = fileSeeds.empty() ? options_.range : fileSeeds.size();
+	if (population == 0) {
+		std::cerr << "SeedSampler::run: No seeds to sample.\n";
+		return false;
+	}
+	IndexDrawer drawer(population, options_.randomSeed);
+
+	const unsigned int numSolvers = options_.numSolvers > 0 ? options_.numSolvers : std::thread::hardware_concurrency();
+	Threadpool pool(numSolvers);
+	std::vector<KlondikeSolver<Rules>> solvers(numSolvers, KlondikeSolver<Rules>(options_.maxStates, priorities));
+	for (auto& solver : solvers)
+		solver.setAutoMoveRules(options_.autoMoveRules);
+
+	const double z = _z_score(options_.confidence);
+	std::cout << "Sampling from " << population << (fileSeeds.empty() ? " seeds from " + std::to_string(options_.firstSeed) : " seeds in " + options_.seedFilePath)
+		<< " with " << numSolvers << " solvers, until each rate is within " << options_.precision * 100 << "% at " << options_.confidence * 100 << "% confidence.\n";
+
+	u64 samples = 0;
+	u64 counts[NUM_RESULTS] = {};
+	std::vector<u64> batch;
+	Interval intervals[NUM_RESULTS];
+	const auto timeStart = Clock::now();
+	for (;;) {
+		u64 batchSize = std::min<u64>(std::max<u32>(options_.batchSize, 1), drawer.remaining());
+		if (options_.maxSamples > 0)
+			batchSize = std::min(batchSize, options_.maxSamples - samples);
+		if (batchSize == 0)
+			break;
+		batch.clear();
+		for (u64 i = 0; i < batchSize; ++i) {
+			const u64 index = drawer.draw();
+			batch.push_back(fileSeeds.empty() ? options_.firstSeed + index : fileSeeds[index]);
+		}
+
+		std::atomic<size_t> next{ 0 };
+		std::atomic<u64> batchCounts[NUM_RESULTS] = {};
+		auto task = [&](KlondikeSolver<Rules>& solver) {
+			for (size_t i = next++; i < batch.size(); i = next++) {
+				solver.setSeed(batch[i]);
+				++batchCounts[toUType(solver.solve().result)];
+			}
+		};
+		std::vector<std::future<void>> threads;
+		threads.reserve(solvers.size());
+		for (auto& solver : solvers)
+			threads.push_back(pool.add(task, std::ref(solver)));
+		for (auto& thread : threads)
+			thread.get();
+
+		samples += batch.size();
+		double widest = 0;
+		for (u8 r = 0; r < NUM_RESULTS; ++r) {
+			counts[r] += batchCounts[r];
+			intervals[r] = _wilson_interval(counts[r], samples, z);
+			widest = std::max(widest, (intervals[r].high - intervals[r].low) / 2);
+		}
+		const double seconds = std::chrono::duration<double>(Clock::now() - timeStart).count();
+		std::cout << "Samples: " << samples;
+		for (u8 r = 0; r < NUM_RESULTS; ++r) {
+			std::cout << "  " << RESULT_NAMES[r] << ": ";
+			_print_percent(intervals[r].estimate);
+			std::cout << " [";
+			_print_percent(intervals[r].low);
+			std::cout << ", ";
+			_print_percent(intervals[r].high);
+			std::cout << "]";
+		}
+		std::cout << "  (" << std::setprecision(1) << (seconds > 0 ? samples / seconds : 0.0) << " seeds/s)\n";
+		std::cout.unsetf(std::ios::floatfield);
+		if (widest <= options_.precision) {
+			std::cout << "Reached the target precision after " << samples << " samples.\n";
+			return true;
+		}
+	}
+	if (drawer.remaining() == 0)
+		std::cout << "Sampled every seed, so the rates are exact for this seed space.\n";
+	else
+		std::cout << "Stopped at the sample limit, short of the target precision.\n";
+	return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "units.hpp"
+#include "AutoMoveRules.hpp"
+
+#include <string>
+
+// Estimates the win, loss and unknown rates of a seed space by solving seeds drawn at random from it, instead of the whole space.
+// Keeps a confidence interval for each rate, and stops once they're all as narrow as asked for.
+
+namespace solitaire {
+	struct SampleOptions {
+		u64 firstSeed{ 0 };
+		u64 range{ 1'000'000'000 };  // Seeds are drawn from [firstSeed, firstSeed + range), unless there's a seed file.
+		std::string seedFilePath;    // If set, seeds are drawn from this file, from the first seed on.
+		u64 maxStates{ 100000 };
+		u8 numSolvers{ 4 };          // 0 to auto-deduce.
+		u8 drawCount{ 3 };
+		AutoMoveRuleSet autoMoveRules{ DEFAULT_AUTO_MOVE_RULES };
+		std::string prioritiesFilePath;
+
+		u32 batchSize{ 1000 };       // Seeds solved between updates of the intervals.
+		double precision{ 0.005 };   // Stop once every interval's half width is at most this.
+		double confidence{ 0.95 };
+		u64 maxSamples{ 0 };         // 0 for no limit (other than running out of seeds).
+		u64 randomSeed{ 1 };         // Seeds the draws, so a run can be repeated.
+	};
+
+	// Draws seeds without replacement, solves each batch on all solvers in parallel, and prints Wilson score intervals after each batch.
+	// The rates are of this solver's outcomes at maxStates, so the unknown rate depends on the budget.
+	class SeedSampler {
+	public:
+		SeedSampler() = default;
+		SeedSampler(SampleOptions options) : options_(std::move(options)) {}
+
+		// Returns false if there is an error.
+		bool run();
+
+	private:
+		template <typename Rules>
+		bool _run();
+
+		SampleOptions options_;
+	};
+}
@@ -0,0 +1,81 @@
+#ifndef SOLITAIRE_H
+#define SOLITAIRE_H
+
+/* C ABI for the Klondike solver library, for calling it in-process from other languages.
+ * Wraps solitaire::BatchSolver (SolverLibrary.hpp). Games are solved on the library's own threads, with no file I/O.
+ * Functions returning int return 0 on success. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32) && defined(SOLITAIRE_SHARED)
+#ifdef SOLITAIRE_BUILDING
+#define SOLITAIRE_API __declspec(dllexport)
+#else
+#define SOLITAIRE_API __declspec(dllimport)
+#endif
+#elif defined(__GNUC__)
+#define SOLITAIRE_API __attribute__((visibility("default")))
+#else
+#define SOLITAIRE_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bumped when a struct or function changes in a way that breaks callers. */
+#define SOLITAIRE_API_VERSION 1
+
+typedef enum solitaire_outcome {
+	SOLITAIRE_WIN = 0,
+	SOLITAIRE_LOSE = 1,
+	SOLITAIRE_UNKNOWN = 2, /* Ran out of states to try. */
+} solitaire_outcome;
+
+/* Auto-move rule bits (see AutoMoveRules.hpp). */
+#define SOLITAIRE_AUTO_MOVE_FOUNDATION     (1u << 0)
+#define SOLITAIRE_AUTO_MOVE_KING           (1u << 1)
+#define SOLITAIRE_AUTO_MOVE_DRAW_ONE_STOCK (1u << 2)
+#define SOLITAIRE_AUTO_MOVE_FORCED         (1u << 3)
+
+typedef struct solitaire_options {
+	uint64_t max_states;      /* 0 for infinite. */
+	uint32_t num_threads;     /* 0 to use every core. */
+	uint32_t draw_count;      /* 1 or 3. */
+	uint32_t auto_move_rules; /* SOLITAIRE_AUTO_MOVE_* bits. */
+	uint32_t keep_solutions;  /* Non-zero to pass solutions to result callbacks. */
+} solitaire_options;
+
+typedef struct solitaire_result {
+	uint64_t seed;            /* Or the deck's index, when solving decks. */
+	uint64_t positions_tried;
+	uint32_t outcome;         /* solitaire_outcome. */
+	uint32_t solution_length; /* Moves in the solution, for wins. */
+} solitaire_result;
+
+/* Called once per game, from the solver threads and not in order. Index is the game's position in the input.
+ * The solution is the moves' packed codes (valid only during the call), or null if solutions aren't kept. */
+typedef void (*solitaire_result_callback)(void* user_data, size_t index, const solitaire_result* result, const uint32_t* solution);
+
+typedef struct solitaire_solver solitaire_solver;
+
+SOLITAIRE_API uint32_t solitaire_api_version(void);
+SOLITAIRE_API void solitaire_default_options(solitaire_options* out_options);
+
+/* Returns null if the options are invalid. */
+SOLITAIRE_API solitaire_solver* solitaire_create(const solitaire_options* options);
+SOLITAIRE_API void solitaire_destroy(solitaire_solver* solver);
+
+SOLITAIRE_API int solitaire_solve_seeds(solitaire_solver* solver, const uint64_t* seeds, size_t count, solitaire_result* out_results);
+SOLITAIRE_API int solitaire_solve_seeds_cb(solitaire_solver* solver, const uint64_t* seeds, size_t count, solitaire_result_callback callback, void* user_data);
+
+/* Decks are 52 card indices each (suit * 13 + rank - 1, with suits hearts, diamonds, clubs, spades), in dealing order. */
+SOLITAIRE_API int solitaire_solve_decks(solitaire_solver* solver, const uint8_t* decks, size_t count, solitaire_result* out_results);
+SOLITAIRE_API int solitaire_solve_decks_cb(solitaire_solver* solver, const uint8_t* decks, size_t count, solitaire_result_callback callback, void* user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
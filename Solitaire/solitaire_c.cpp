@@ -0,0 +1,117 @@
+#define SOLITAIRE_BUILDING
+#include "solitaire.h"
+
+#include "SolverLibrary.hpp"
+
+#include <iostream>
+#include <vector>
+
+using namespace solitaire;
+
+struct solitaire_solver {
+	BatchSolver solver;
+};
+
+namespace {
+	static_assert(SOLITAIRE_AUTO_MOVE_FOUNDATION == AutoMoveRuleBit(AutoMoveRule::SAFE_FOUNDATION)
+		&& SOLITAIRE_AUTO_MOVE_KING == AutoMoveRuleBit(AutoMoveRule::KING_TO_SPACE)
+		&& SOLITAIRE_AUTO_MOVE_DRAW_ONE_STOCK == AutoMoveRuleBit(AutoMoveRule::DRAW_ONE_STOCK)
+		&& SOLITAIRE_AUTO_MOVE_FORCED == AutoMoveRuleBit(AutoMoveRule::FORCED_MOVE), "C auto-move bits must match the rules.");
+	static_assert(SOLITAIRE_WIN == toUType(GameResult::Result::WIN) && SOLITAIRE_LOSE == toUType(GameResult::Result::LOSE)
+		&& SOLITAIRE_UNKNOWN == toUType(GameResult::Result::UNKNOWN), "C outcomes must match the results.");
+
+	solitaire_result _to_c_result(const GameResult& result) {
+		return solitaire_result{ result.seed, result.positionsTried, static_cast<uint32_t>(toUType(result.result)), static_cast<uint32_t>(result.solution.size()) };
+	}
+
+	BatchSolver::ResultCallback _to_callback(solitaire_result_callback callback, void* userData) {
+		return [callback, userData](std::size_t index, GameResult& result) {
+			const solitaire_result cResult = _to_c_result(result);
+			if (result.solution.empty()) {
+				callback(userData, index, &cResult, nullptr);
+				return;
+			}
+			std::vector<uint32_t> codes;
+			codes.reserve(result.solution.size());
+			for (const Move& move : result.solution)
+				codes.push_back(move.getCode());
+			callback(userData, index, &cResult, codes.data());
+		};
+	}
+
+	bool _read_decks(const uint8_t* cards, size_t count, std::vector<Deck>& out_decks) {
+		out_decks.assign(count, Deck());
+		for (size_t i = 0; i < count; ++i) {
+			out_decks[i].reserve(CARDS_PER_DECK);
+			for (u8 k = 0; k < CARDS_PER_DECK; ++k) {
+				const uint8_t index = cards[i * CARDS_PER_DECK + k];
+				if (index >= CARDS_PER_DECK) {
+					std::cerr << "solitaire_solve_decks: Invalid card index " << static_cast<u32>(index) << " in deck " << i << ".\n";
+					return false;
+				}
+				out_decks[i].push_back(CardFromIndex(index));
+			}
+		}
+		return true;
+	}
+}
+
+uint32_t solitaire_api_version(void) {
+	return SOLITAIRE_API_VERSION;
+}
+
+void solitaire_default_options(solitaire_options* out_options) {
+	if (!out_options)
+		return;
+	const SolveOptions defaults;
+	*out_options = solitaire_options{ defaults.maxStates, defaults.numThreads, defaults.drawCount, static_cast<uint32_t>(defaults.autoMoveRules), defaults.keepSolutions ? 1u : 0u };
+}
+
+solitaire_solver* solitaire_create(const solitaire_options* options) {
+	if (!options || (options->draw_count != 1 && options->draw_count != 3) || options->num_threads > 255
+		|| (options->auto_move_rules >> NUM_AUTO_MOVE_RULES) != 0)
+		return nullptr;
+	SolveOptions solveOptions;
+	solveOptions.maxStates = options->max_states;
+	solveOptions.numThreads = static_cast<u8>(options->num_threads);
+	solveOptions.drawCount = static_cast<u8>(options->draw_count);
+	solveOptions.autoMoveRules = options->auto_move_rules;
+	solveOptions.keepSolutions = options->keep_solutions != 0;
+	try {
+		return new solitaire_solver{ BatchSolver(solveOptions) };
+	} catch (...) {
+		return nullptr; // Don't let exceptions (EG failing to start threads) cross the C ABI.
+	}
+}
+
+void solitaire_destroy(solitaire_solver* solver) {
+	delete solver;
+}
+
+int solitaire_solve_seeds(solitaire_solver* solver, const uint64_t* seeds, size_t count, solitaire_result* out_results) {
+	if (!solver || (count > 0 && (!seeds || !out_results)))
+		return -1;
+	auto onResult = [out_results](std::size_t index, GameResult& result) { out_results[index] = _to_c_result(result); };
+	return solver->solver.solveSeeds(seeds, count, onResult) ? 0 : -1;
+}
+
+int solitaire_solve_seeds_cb(solitaire_solver* solver, const uint64_t* seeds, size_t count, solitaire_result_callback callback, void* user_data) {
+	if (!solver || !callback || (count > 0 && !seeds))
+		return -1;
+	return solver->solver.solveSeeds(seeds, count, _to_callback(callback, user_data)) ? 0 : -1;
+}
+
+int solitaire_solve_decks(solitaire_solver* solver, const uint8_t* decks, size_t count, solitaire_result* out_results) {
+	std::vector<Deck> cppDecks;
+	if (!solver || (count > 0 && (!decks || !out_results)) || !_read_decks(decks, count, cppDecks))
+		return -1;
+	auto onResult = [out_results](std::size_t index, GameResult& result) { out_results[index] = _to_c_result(result); };
+	return solver->solver.solveDecks(cppDecks.data(), count, onResult) ? 0 : -1;
+}
+
+int solitaire_solve_decks_cb(solitaire_solver* solver, const uint8_t* decks, size_t count, solitaire_result_callback callback, void* user_data) {
+	std::vector<Deck> cppDecks;
+	if (!solver || !callback || (count > 0 && (!decks || !_read_decks(decks, count, cppDecks))))
+		return -1;
+	return solver->solver.solveDecks(cppDecks.data(), count, _to_callback(callback, user_data)) ? 0 : -1;
+}
@@ -0,0 +1,184 @@
+#include "tuner.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include "KlondikeSolver.hpp"
+#include "MovePriorities.hpp"
+#include "threadpool/threadpool/Threadpool.hpp"
+
+using namespace solitaire;
+
+namespace {
+	constexpr u64 NO_POSITION_LIMIT = std::numeric_limits<u64>::max();
+
+	bool _is_conclusive(GameResult::Result r) {
+		return r != GameResult::Result::UNKNOWN;
+	}
+
+	// Solves the training corpus with a given priority table, spread over all solvers.
+	template <typename Rules>
+	class CorpusEvaluator {
+	public:
+		CorpusEvaluator(std::vector<u64> seeds, u64 maxStates, unsigned int numSolvers, AutoMoveRuleSet autoMoveRules)
+			: seeds_(std::move(seeds)), pool_(numSolvers), solvers_(numSolvers, KlondikeSolver<Rules>(maxStates)) {
+			for (auto& solver : solvers_)
+				solver.setAutoMoveRules(autoMoveRules);
+		}
+
+		// Returns false if the evaluation was abandoned, because the total positions tried went over the limit,
+		// or a result differed from a WIN or LOSE in the reference results.
+		bool evaluate(const MovePriorities& priorities, u64 positionLimit, const std::vector<GameResult::Result>* reference,
+			u64& out_total_positions, std::vector<GameResult::Result>& out_results) {
+			std::atomic<size_t> nextSeed{ 0 };
+			std::atomic<u64> totalPositions{ 0 };
+			std::atomic<bool> abandoned{ false };
+			out_results.assign(seeds_.size(), GameResult::Result::UNKNOWN);
+
+			auto task = [&](KlondikeSolver<Rules>& solver) {
+				solver.setPriorities(priorities);
+				for (size_t i = nextSeed++; i < seeds_.size() && !abandoned; i = nextSeed++) {
+					solver.setSeed(seeds_[i]);
+					const GameResult result = solver.solve();
+					out_results[i] = result.result;
+					if (totalPositions += result.positionsTried; totalPositions > positionLimit)
+						abandoned = true;
+					else if (reference && _is_conclusive((*reference)[i]) && (*reference)[i] != result.result)
+						abandoned = true;
+				}
+			};
+
+			std::vector<std::future<void>> threads;
+			threads.reserve(solvers_.size());
+			for (auto& solver : solvers_)
+				threads.push_back(pool_.add(task, std::ref(solver)));
+			for (auto& thread : threads)
+				thread.get();
+
+			out_total_positions = totalPositions;
+			return !abandoned;
+		}
+
+		size_t size() const { return seeds_.size(); }
+
+	private:
+		std::vector<u64> seeds_;
+		Threadpool pool_;
+		std::vector<KlondikeSolver<Rules>> solvers_;
+	};
+
+	bool _load_corpus(const TuneOptions& options, std::vector<u64>& out_seeds) {
+		out_seeds.reserve(options.numSeeds);
+		if (options.seedFilePath.empty()) {
+			for (u64 seed = options.firstSeed; out_seeds.size() < options.numSeeds; ++seed)
+				out_seeds.push_back(seed);
+			return true;
+		}
+		std::ifstream seedFile(options.seedFilePath);
+		if (!seedFile.is_open()) {
+			std::cerr << "PriorityTuner: Failed to open seed file.\n";
+			return false;
+		}
+		u64 seed;
+		bool foundFirst = false;
+		while (out_seeds.size() < options.numSeeds && seedFile >> seed) {
+			foundFirst = foundFirst || seed == options.firstSeed;
+			if (foundFirst)
+				out_seeds.push_back(seed);
+		}
+		if (out_seeds.empty()) {
+			std::cerr << "PriorityTuner: No seeds found in seed file.\n";
+			return false;
+		}
+		return true;
+	}
+
+	void _print_priorities(const MovePriorities& priorities) {
+		for (const auto& field : MOVE_PRIORITY_FIELDS)
+			std::cout << "  " << field.name << " " << priorities.*field.weight << "\n";
+	}
+}
+
+bool PriorityTuner::run() {
+	switch (options_.drawCount) {
+	case 1: return _run<DrawOneRules>();
+	case 3: return _run<DrawThreeRules>();
+	default:
+		std::cerr << "PriorityTuner::run: Unsupported stock draw count (" << static_cast<u32>(options_.drawCount) << ").\n";
+		return false;
+	}
+}
+
+template <typename Rules>
+bool PriorityTuner::_run() {
+	MovePriorities best;
+	if (!options_.prioritiesFilePath.empty() && !LoadMovePriorities(options_.prioritiesFilePath, best))
+		return false;
+
+	std::vector<u64> seeds;
+	if (!_load_corpus(options_, seeds))
+		return false;
+
+	const unsigned int numSolvers = options_.numSolvers > 0 ? options_.numSolvers : std::thread::hardware_concurrency();
+	CorpusEvaluator<Rules> evaluator(std::move(seeds), options_.maxStates, numSolvers, options_.autoMoveRules);
+
+	std::cout << "Tuning move priorities over " << evaluator.size() << " seeds with " << numSolvers << " solvers.\n";
+
+	// The starting table's results are the ones that must be preserved.
+	std::vector<GameResult::Result> reference, results;
+	u64 bestTotal;
+	evaluator.evaluate(best, NO_POSITION_LIMIT, nullptr, bestTotal, reference);
+	const u64 startTotal = bestTotal;
+	std::cout << "Starting positions tried: " << startTotal << "\n";
+
+	constexpr size_t numFields = std::size(MOVE_PRIORITY_FIELDS);
+	std::vector<std::int32_t> steps(numFields);
+	for (size_t i = 0; i < numFields; ++i)
+		steps[i] = std::max(1, std::abs(best.*MOVE_PRIORITY_FIELDS[i].weight) / 4);
+
+	for (u32 round = 1; round <= options_.maxRounds; ++round) {
+		bool improved = false;
+		for (size_t i = 0; i < numFields; ++i) {
+			for (const std::int32_t direction : { 1, -1 }) {
+				MovePriorities candidate(best);
+				candidate.*MOVE_PRIORITY_FIELDS[i].weight += direction * steps[i];
+				u64 total;
+				if (!evaluator.evaluate(candidate, bestTotal - 1, &reference, total, results))
+					continue;
+				std::cout << "Round " << round << ": " << MOVE_PRIORITY_FIELDS[i].name << " " << best.*MOVE_PRIORITY_FIELDS[i].weight
+					<< " -> " << candidate.*MOVE_PRIORITY_FIELDS[i].weight << ", positions tried: " << total << "\n";
+				best = candidate;
+				bestTotal = total;
+				improved = true;
+				// Unknown results that the new table solved are kept from here on.
+				for (size_t k = 0; k < reference.size(); ++k) {
+					if (!_is_conclusive(reference[k]))
+						reference[k] = results[k];
+				}
+				if (!WriteMovePriorities(options_.outputPath, best))
+					return false;
+				break;
+			}
+		}
+		if (!improved) {
+			if (std::all_of(steps.begin(), steps.end(), [](std::int32_t step) { return step == 1; }))
+				break; // Converged.
+			for (auto& step : steps)
+				step = std::max(1, step / 2);
+		}
+	}
+
+	if (!WriteMovePriorities(options_.outputPath, best))
+		return false;
+	std::cout << "Best positions tried: " << bestTotal << " (from " << startTotal << ")\n";
+	_print_priorities(best);
+	std::cout << "Wrote priorities to " << options_.outputPath << "\n";
+	return true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "units.hpp"
+#include "AutoMoveRules.hpp"
+
+#include <string>
+
+// Offline tuner for the solver's move priorities. Searches the weight space over a training corpus of seeds,
+// and writes the best table found out as a priorities file that the batch runner can load.
+
+namespace solitaire {
+	struct TuneOptions {
+		u64 firstSeed{ 0 };
+		u32 numSeeds{ 500 }; // Size of the training corpus.
+		u64 maxStates{ 100000 };
+		u8 numSolvers{ 4 };
+		u8 drawCount{ 3 };
+		AutoMoveRuleSet autoMoveRules{ DEFAULT_AUTO_MOVE_RULES };
+		u32 maxRounds{ 20 };
+
+		std::string seedFilePath;        // If set, the corpus is read from this file, starting at the first seed.
+		std::string prioritiesFilePath;  // Weights to start from. Uses the defaults if not set.
+		std::string outputPath{ "./priorities.txt" };
+	};
+
+	// Minimizes the total positions tried over the corpus with coordinate descent, never accepting weights that change
+	// a WIN or LOSE result. Each candidate table is evaluated on all solvers in parallel.
+	class PriorityTuner {
+	public:
+		PriorityTuner() = default;
+		PriorityTuner(TuneOptions options) : options_(std::move(options)) {}
+
+		// Returns false if there is an error.
+		bool run();
+
+	private:
+		template <typename Rules>
+		bool _run();
+
+		TuneOptions options_;
+	};
+}
@@ -0,0 +1,128 @@
+#include "verifier.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "KlondikeSolver.hpp"
+#include "SolutionArchive.hpp"
+#include "threadpool/threadpool/Threadpool.hpp"
+
+using Clock = std::chrono::high_resolution_clock;
+
+using namespace solitaire;
+
+namespace {
+	struct ArchivedSolution {
+		u64 seed{ 0 };
+		MoveList moves;
+		bool parsed{ true };
+	};
+
+	// Returns an empty string if the solution is valid, otherwise why it isn't.
+	template <typename Rules>
+	std::string _verify_solution(const ArchivedSolution& solution) {
+		if (!solution.parsed)
+			return "malformed line";
+		KlondikeGame<Rules> game(solution.seed);
+		game.setUpGame();
+		for (size_t i = 0; i < solution.moves.size(); ++i) {
+			if (!KlondikeSolver<Rules>::tryDoMove(game, solution.moves[i])) {
+				std::stringstream error;
+				error << "illegal move " << i << " (" << MoveToStr(solution.moves[i]) << ", code " << std::hex << solution.moves[i].getCode() << ")";
+				return error.str();
+			}
+		}
+		return game.isGameWon() ? std::string() : "game not won";
+	}
+
+	// Read up to a chunk of solutions. Returns false at the end of the archive.
+	bool _read_chunk(std::ifstream& archive, u32 chunkSize, std::vector<ArchivedSolution>& out_chunk) {
+		out_chunk.clear();
+		std::string line;
+		while (out_chunk.size() < chunkSize && std::getline(archive, line)) {
+			if (line.empty())
+				continue;
+			ArchivedSolution& solution = out_chunk.emplace_back();
+			solution.parsed = ParseSolution(line, solution.seed, solution.moves);
+		}
+		return !out_chunk.empty();
+	}
+}
+
+bool SolutionVerifier::run() {
+	switch (options_.drawCount) {
+	case 1: return _run<DrawOneRules>();
+	case 3: return _run<DrawThreeRules>();
+	default:
+		std::cerr << "SolutionVerifier::run: Unsupported stock draw count (" << static_cast<u32>(options_.drawCount) << ").\n";
+		return false;
+	}
+}
+
+template <typename Rules>
+bool SolutionVerifier::_run() {
+	std::ifstream archive(options_.archivePath);
+	if (!archive.is_open()) {
+		std::cerr << "SolutionVerifier::run: Failed to open solutions archive: " << options_.archivePath << "\n";
+		return false;
+	}
+	std::ofstream invalidFile(options_.invalidPath, std::ios::trunc);
+	if (!invalidFile.is_open()) {
+		std::cerr << "SolutionVerifier::run: Failed to open invalid solutions file: " << options_.invalidPath << "\n";
+		return false;
+	}
+
+	const unsigned int numThreads = options_.numThreads > 0 ? options_.numThreads : std::thread::hardware_concurrency();
+	Threadpool pool(numThreads);
+	std::cout << "Verifying solutions in " << options_.archivePath << " with " << numThreads << " threads.\n";
+
+	u64 verified{ 0 }, totalMoves{ 0 };
+	std::vector<std::pair<u64, std::string>> invalid;
+	std::vector<ArchivedSolution> chunk;
+	std::mutex invalidMutex;
+	const auto timeStart = Clock::now();
+	while (_read_chunk(archive, std::max<u32>(options_.chunkSize, 1), chunk)) {
+		std::atomic<size_t> next{ 0 };
+		auto task = [&] {
+			for (size_t i = next++; i < chunk.size(); i = next++) {
+				if (std::string error = _verify_solution<Rules>(chunk[i]); !error.empty()) {
+					std::lock_guard<std::mutex> lock(invalidMutex);
+					invalid.emplace_back(chunk[i].seed, std::move(error));
+				}
+			}
+		};
+		std::vector<std::future<void>> threads;
+		threads.reserve(numThreads);
+		for (unsigned int i = 0; i < numThreads; ++i)
+			threads.push_back(pool.add(task));
+		for (auto& thread : threads)
+			thread.get();
+
+		verified += chunk.size();
+		for (const auto& solution : chunk)
+			totalMoves += solution.moves.size();
+		std::cout << "\rSolutions checked: " << verified << std::flush;
+	}
+	const double seconds = std::chrono::duration<double>(Clock::now() - timeStart).count();
+
+	std::sort(invalid.begin(), invalid.end());
+	for (const auto& [seed, error] : invalid)
+		invalidFile << seed << " " << error << "\n";
+
+	std::cout << "\nChecked " << verified << " solutions (" << totalMoves << " moves) in " << seconds << " seconds.\n";
+	if (seconds > 0)
+		std::cout << "Throughput: " << static_cast<u64>(verified / seconds) << " solutions/s, " << static_cast<u64>(totalMoves / seconds) << " moves/s.\n";
+	if (invalid.empty()) {
+		std::cout << "All solutions are valid.\n";
+		return true;
+	}
+	std::cout << invalid.size() << " invalid solutions written to: " << options_.invalidPath << "\n";
+	return false;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "units.hpp"
+
+#include <string>
+
+// Bulk verifier for archived solutions. Replays every solution against a freshly dealt game with a full rules check
+// on each move, and confirms that it ends in a won game.
+
+namespace solitaire {
+	struct VerifyOptions {
+		std::string archivePath;  // Solutions archive to check (EG <output dir>/solutions.txt).
+		std::string invalidPath;  // Where to write the seeds that failed, with the reason.
+		u8 numThreads{ 4 };       // 0 to auto-deduce.
+		u8 drawCount{ 3 };        // Ruleset the solutions were found for.
+		u32 chunkSize{ 100000 };  // Solutions read into memory at a time.
+	};
+
+	class SolutionVerifier {
+	public:
+		SolutionVerifier() = default;
+		SolutionVerifier(VerifyOptions options) : options_(std::move(options)) {}
+
+		// Returns false if there is an error, or any solution is invalid.
+		bool run();
+
+	private:
+		template <typename Rules>
+		bool _run();
+
+		VerifyOptions options_;
+	};
+}